@@ -39,6 +39,11 @@
 #include <rtt/ConnPolicy.hpp>
 #include <rtt/plugin/PluginLoader.hpp>
 #include <rtt/types/GlobalsRepository.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <rtt/internal/ConnectionManager.hpp>
+#include <rtt/internal/ConnID.hpp>
 
 # if defined(_POSIX_VERSION)
 #   define USE_SIGNALS 1
@@ -49,6 +54,7 @@
 #endif
 
 #include <boost/algorithm/string.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <rtt/base/OperationCallerBaseInvoker.hpp>
 
 #include <cstdio>
@@ -62,6 +68,8 @@
 #include <iostream>
 #include <fstream>
 #include <set>
+#include <algorithm>
+#include <sstream>
 
 
 
@@ -91,6 +99,50 @@ namespace OCL
     }
 #endif
 
+    /**
+     * Calls start() or stop() on a single component. It is run in an
+     * Activity of its own by startStopComponentsParallel(), such that
+     * a slow startHook() or stopHook() does not delay independent
+     * components.
+     */
+    class StartStopJob
+        : public base::RunnableInterface
+    {
+        TaskContext* tc;
+        bool dostart;
+        os::AtomicInt finished;
+        bool result;
+    public:
+        StartStopJob(TaskContext* c, bool start)
+            : tc(c), dostart(start), finished(0), result(false)
+        {}
+        bool initialize() { return true; }
+        void step() {
+            OperationCaller<bool(void)> op = tc->getOperation( dostart ? "start" : "stop" );
+            result = op();
+            finished.set(1);
+        }
+        void finalize() {}
+        bool isFinished() { return finished.read() == 1; }
+        bool getResult() const { return result; }
+    };
+
+    /**
+     * True if \a reader still has a connection from \a writer, which
+     * may have been removed since with disconnect().
+     */
+    static bool stillConnected(base::OutputPortInterface* writer, base::InputPortInterface* reader)
+    {
+        if ( !writer->connected() || !reader->connected() )
+            return false;
+        boost::scoped_ptr<internal::ConnID> wid( writer->getPortID() );
+        std::list<internal::ConnectionManager::ChannelDescriptor> channels = reader->getManager()->getChannels();
+        for (std::list<internal::ConnectionManager::ChannelDescriptor>::iterator it = channels.begin(); it != channels.end(); ++it)
+            if ( boost::tuples::get<0>(*it) && boost::tuples::get<0>(*it)->isSameID( *wid ) )
+                return true;
+        return false;
+    }
+
 #define ORO_str(s) ORO__str(s)
 #define ORO__str(s) #s
 
@@ -100,6 +152,15 @@ namespace OCL
           autoUnload("AutoUnload",
                      "Stop, cleanup and unload all components loaded by the DeploymentComponent when it is destroyed.",
                      true),
+          parallelStartStop("ParallelStartStop",
+                     "Start and stop components of the same group concurrently, respecting their DependsOn ordering.",
+                     false),
+          startStopTimeout("StartStopTimeout",
+                     "Default time in seconds a component may take to start or stop when ParallelStartStop is set.",
+                     5.0),
+          autoPlacement("AutoPlacement",
+                     "Call placeActivities() before starting a group of components.",
+                     false),
           validConfig("Valid", false),
           sched_RT("ORO_SCHED_RT", ORO_SCHED_RT ),
           sched_OTHER("ORO_SCHED_OTHER", ORO_SCHED_OTHER ),
@@ -112,6 +173,9 @@ namespace OCL
         this->addProperty( "RTT_COMPONENT_PATH", compPath ).doc("Locations to look for components. Use a colon or semi-colon separated list of paths. Defaults to the environment variable with the same name.");
         this->addProperty( "DefaultWaitPeriodPolicy", defaultWaitPeriodPolicy ).doc("The default value for the wait period policy property for threads of newly created activities (ORO_WAIT_ABS or ORO_WAIT_REL).");
         this->addProperty( autoUnload );
+        this->addProperty( parallelStartStop );
+        this->addProperty( startStopTimeout );
+        this->addProperty( autoPlacement );
         this->addAttribute( target );
 
         this->addAttribute( validConfig );
@@ -133,6 +197,8 @@ namespace OCL
         // avoid warning about overriding
         this->provides()->removeOperation("loadService");
         this->addOperation("loadService", &DeploymentComponent::loadService, this, ClientThread).doc("Load a discovered service or plugin in an existing component.").arg("Name", "The name of the component which will receive the service").arg("Service", "The name of the service or plugin.");
+        this->addOperation("hotSwapComponent", &DeploymentComponent::hotSwapComponent, this, ClientThread).doc("Replace a loaded component by a new instance, keeping its properties, connections and peers.").arg("Name", "The name of the loaded component").arg("Type", "The component type of the new instance.");
+        this->addOperation("loadServiceInComponents", &DeploymentComponent::loadServiceInComponents, this, ClientThread).doc("Load a discovered service or plugin in all components of this deployer.").arg("Service", "The name of the service or plugin.");
         this->addOperation("unloadComponent", &DeploymentComponent::unloadComponent, this, ClientThread).doc("Unload a loaded component instance.").arg("Name", "The name of the to be created component");
         this->addOperation("displayComponentTypes", &DeploymentComponent::displayComponentTypes, this, ClientThread).doc("Print out a list of all component types this component can create.");
         this->addOperation("getComponentTypes", &DeploymentComponent::getComponentTypes, this, ClientThread).doc("return a vector of all component types this component can create.");
@@ -140,6 +206,7 @@ namespace OCL
         this->addOperation("loadConfiguration", &DeploymentComponent::loadConfiguration, this, ClientThread).doc("Load a new XML configuration from a file (identical to loadComponents).").arg("File", "The file which contains the new configuration.");
         this->addOperation("loadConfigurationString", &DeploymentComponent::loadConfigurationString, this, ClientThread).doc("Load a new XML configuration from a string.").arg("Text", "The string which contains the new configuration.");
         this->addOperation("clearConfiguration", &DeploymentComponent::clearConfiguration, this, ClientThread).doc("Clear all configuration settings.");
+        this->addOperation("addDependency", &DeploymentComponent::addDependency, this, ClientThread).doc("Declare that a component may only be started after, and stopped before, another component when ParallelStartStop is set.").arg("CompName", "The dependent component.").arg("DependsOn", "The component it depends on.");
 
         this->addOperation("loadComponents", &DeploymentComponent::loadComponents, this, ClientThread).doc("Load components listed in an XML configuration file.").arg("File", "The file which contains the new configuration.");
         this->addOperation("configureComponents", &DeploymentComponent::configureComponents, this, ClientThread).doc("Apply a loaded configuration to the components and configure() them if AutoConf is set.");
@@ -210,6 +277,7 @@ namespace OCL
 			.arg("Priority", "The priority of the activity.")
 			.arg("SchedType", "The scheduler type of the activity.");
 
+        this->addOperation("placeActivities", &DeploymentComponent::placeActivities, this, ClientThread).doc("Pin periodic real-time activities to CPUs sharing a cache, keeping communicating components together.");
         this->addOperation("setWaitPeriodPolicy", &DeploymentComponent::setWaitPeriodPolicy, this, ClientThread).doc("Sets the wait period policy of an existing component thread.").arg("CompName", "The name of the Component.").arg("Policy", "The new policy (ORO_WAIT_ABS or ORO_WAIT_REL).");
 
         valid_names.insert("AutoUnload");
@@ -226,6 +294,8 @@ namespace OCL
         valid_names.insert("StateMachineScript");
         valid_names.insert("Ports");
         valid_names.insert("Peers");
+        valid_names.insert("DependsOn");
+        valid_names.insert("StartStopTimeout");
         valid_names.insert("Activity");
         valid_names.insert("Master");
         valid_names.insert("Properties");
@@ -580,6 +650,25 @@ namespace OCL
         return porti->createStream( policy );
     }
 
+    /**
+     * Adds the arguments of a connectServices() or connectOperations()
+     * call to \a bindings, unless they are in it already.
+     */
+    static void rememberBinding(std::vector<std::pair<std::string, std::string> >& bindings, const std::string& one, const std::string& other)
+    {
+        std::pair<std::string, std::string> b( one, other );
+        if ( std::find( bindings.begin(), bindings.end(), b ) == bindings.end() )
+            bindings.push_back( b );
+    }
+
+    /**
+     * The component name of a dot-separated path of a binding.
+     */
+    static std::string bindingComponent(const std::string& path)
+    {
+        return path.substr( 0, path.find('.') );
+    }
+
     bool DeploymentComponent::connectServices(const std::string& one, const std::string& other)
     {
     RTT::Logger::In in("connectServices");
@@ -595,7 +684,10 @@ namespace OCL
             return false;
         }
 
-        return a->connectServices(b);
+        if ( !a->connectServices(b) )
+            return false;
+        rememberBinding( service_bindings, one, other );
+        return true;
     }
 
     bool DeploymentComponent::connectOperations(const std::string& required, const std::string& provided)
@@ -630,9 +722,11 @@ namespace OCL
         }
         // Connection
         rop->setImplementation(p->getLocalOperation( pop_name ), r->getServiceOwner()->engine());
-        if ( rop->ready() )
-            log(Debug) << "Successfully set up OperationCaller for operation " << rop_name << endlog();
-        return rop->ready();
+        if ( !rop->ready() )
+            return false;
+        log(Debug) << "Successfully set up OperationCaller for operation " << rop_name << endlog();
+        rememberBinding( operation_bindings, required, provided );
+        return true;
     }
 
     int string_to_oro_sched(const std::string& sched) {
@@ -997,6 +1091,36 @@ namespace OCL
                                     compmap[comp.getName()].use_naming = ps.get();
                                 continue;
                             }
+                            if ( (*optit)->getName() == "StartStopTimeout" ) {
+                                RTT::Property<double> ps = comp.rvalue().getProperty("StartStopTimeout");
+                                if (!ps.ready() || ps.get() < 0.0) {
+                                    log(Error) << "StartStopTimeout must be of type <double> and not negative" << endlog();
+                                    valid = false;
+                                } else
+                                    compmap[comp.getName()].startstop_timeout = ps.get();
+                                continue;
+                            }
+                            if ( (*optit)->getName() == "DependsOn" ) {
+                                RTT::Property<RTT::PropertyBag> deps = *optit;
+                                if ( !deps.ready() ) {
+                                    log(Error) << "DependsOn must be a 'struct', was type "<< (*optit)->getType() << endlog();
+                                    valid = false;
+                                    continue;
+                                }
+                                for (RTT::PropertyBag::const_iterator dit= deps.rvalue().begin(); dit != deps.rvalue().end();dit++) {
+                                    RTT::Property<std::string> dep = *dit;
+                                    if ( !dep.ready() ) {
+                                        log(Error) << "Wrong property type in DependsOn struct. Expected property of type 'string',"
+                                                   << " got type "<< (*dit)->getType() <<endlog();
+                                        valid = false;
+                                        continue;
+                                    }
+                                    std::vector<std::string>& cdeps = compmap[comp.getName()].dependencies;
+                                    if ( std::find( cdeps.begin(), cdeps.end(), dep.get() ) == cdeps.end() )
+                                        cdeps.push_back( dep.get() );
+                                }
+                                continue;
+                            }
                             if ( (*optit)->getName() == "PropertyFile" ) {
                                 RTT::Property<string> ps = comp.rvalue().getProperty("PropertyFile");
                                 if (!ps.ready()) {
@@ -1272,83 +1396,113 @@ namespace OCL
         return !failure && valid;
     }
 
-    bool DeploymentComponent::createDataPortConnections(const bool skipUnconnected)
+    bool DeploymentComponent::createDataPortConnections(const bool skipUnconnected, RTT::TaskContext* only)
     {
         bool valid = true;
+        // summary counters, reported once instead of once per connection.
+        unsigned int created = 0, existing = 0, failed = 0, skipped = 0;
 
         for(ConMap::iterator it = conmap.begin(); it != conmap.end(); ++it) {
             ConnectionData *connection =  &(it->second);
-            std::string connection_name = it->first;
+            const std::string& connection_name = it->first;
+
+            if ( only && std::find( connection->owners.begin(), connection->owners.end(), only ) == connection->owners.end() )
+                continue;
             
             if ( connection->ports.size() == 1) {
-                string owner = connection->owners[0]->getName();
-                string portname = connection->ports.front()->getName();
-                string porttype = dynamic_cast<InputPortInterface*>(connection->ports.front() ) ? "InputPort" : "OutputPort";
-
+                base::PortInterface* port = connection->ports.front();
                 // a connection that currently has only one port may end up with
                 // two ports later on, so we skip this connection for now.
                 if (skipUnconnected)
                 {
-                    log(Info) << "Skipping connection with name "<<connection_name<<" with only one Port "<<portname<<" from "<< owner << endlog();
+                    log(Debug) << "Skipping connection with name "<<connection_name<<" with only one Port "<<port->getName()<<" from "<< connection->owners[0]->getName() << endlog();
+                    ++skipped;
+                }
+                else if ( connection->established.count( std::make_pair( port, (base::PortInterface*)0 ) ) && port->connected() ) {
+                    ++existing;
                 }
-                else if ( connection->ports.front()->createStream( connection->policy ) == false) {
-                    log(Warning) << "Creating stream with name "<<connection_name<<" with Port "<<portname<<" from "<< owner << " failed."<< endlog();
+                else if ( port->createStream( connection->policy ) == false) {
+                    log(Warning) << "Creating stream with name "<<connection_name<<" with Port "<<port->getName()<<" from "<< connection->owners[0]->getName() << " failed."<< endlog();
+                    ++failed;
                 } else {
-                    log(Info) << "Component "<< owner << "'s " + porttype<< " " + portname << " will stream to "<< connection->policy.name_id << endlog();
+                    log(Info) << "Component "<< connection->owners[0]->getName() << "'s " << (dynamic_cast<InputPortInterface*>(port) ? "InputPort" : "OutputPort")
+                              << " " << port->getName() << " will stream to "<< connection->policy.name_id << endlog();
+                    connection->established.insert( std::make_pair( port, (base::PortInterface*)0 ) );
+                    ++created;
                 }
                 continue;
             }
-            // first find all write ports.
-            base::PortInterface* writer = 0;
-            ConnectionData::Ports::iterator p = connection->ports.begin();
-            
-            // If one of the ports is connected, use that one as writer to connect to.
+
+            // Partition the ports of this topic once into writers and readers.
             vector<OutputPortInterface*> writers;
-            while (p !=connection->ports.end() ) {
-                if ( OutputPortInterface* out = dynamic_cast<base::OutputPortInterface*>( *p ) ) {
-                    if ( writer ) {
-                        log(Info) << "Forming multi-output connections with additional OutputPort " << (*p)->getName() << "."<<endlog();
-                    } else
-                    writer = *p;
+            vector<TaskContext*> writer_owners;
+            vector<InputPortInterface*> readers;
+            vector<TaskContext*> reader_owners;
+            for (size_t i = 0; i != connection->ports.size(); ++i) {
+                if ( OutputPortInterface* out = dynamic_cast<base::OutputPortInterface*>( connection->ports[i] ) ) {
                     writers.push_back( out );
-                    std::string owner = it->second.owners[p - it->second.ports.begin()]->getName();
-                    log(Info) << "Component "<< owner << "'s OutputPort "<< writer->getName()<< " will write topic "<<it->first<< endlog();
+                    writer_owners.push_back( connection->owners[i] );
+                } else if ( InputPortInterface* in = dynamic_cast<base::InputPortInterface*>( connection->ports[i] ) ) {
+                    readers.push_back( in );
+                    reader_owners.push_back( connection->owners[i] );
                 }
-                ++p;
             }
             
             // Inform the user of non-optimal connections:
-            if ( writer == 0 ) {
-                log(Error) << "No OutputPort listed that writes " << it->first << endlog();
+            if ( writers.empty() ) {
+                log(Error) << "No OutputPort listed that writes " << connection_name << endlog();
                 valid = false;
                 break;
             }
-            
-            // connect all ports to writer
-            p = connection->ports.begin();
-            vector<OutputPortInterface*>::iterator w = writers.begin();
-            
-            while (w != writers.end() ) {
-                while (p != connection->ports.end() ) {
-                    // connect all readers to the list of writers
-                    if ( dynamic_cast<base::InputPortInterface*>( *p ) )
-                    {
-                        string owner = connection->owners[p - connection->ports.begin()]->getName();
-                        // only try to connect p if it is not in the same connection of writer.
-                        // OK. p is definately no part of writer's connection. Try to connect and flag errors if it fails.
-                        if ( (*w)->connectTo( *p, connection->policy ) == false) {
-                            log(Error) << "Could not subscribe InputPort "<< owner<<"."<< (*p)->getName() << " to topic " << (*w)->getName() <<'/'<< connection_name <<endlog();
-                            valid = false;
-                        } else {
-                            log(Info) << "Subscribed InputPort "<< owner<<"."<< (*p)->getName() <<" to topic " << (*w)->getName() <<'/'<< connection_name <<endlog();
+            if ( writers.size() > 1 )
+                log(Info) << "Forming multi-output connection " << connection_name << " with " << writers.size() << " OutputPorts." << endlog();
+
+            // Check type compatibility once per topic, against the first writer.
+            const types::TypeInfo* ti = writers.front()->getTypeInfo();
+            for (size_t i = 0; i != connection->ports.size(); ++i) {
+                if ( connection->ports[i]->getTypeInfo() != ti ) {
+                    log(Error) << "Port " << connection->owners[i]->getName() << "." << connection->ports[i]->getName()
+                               << " does not have the same data type as the other ports of topic " << connection_name << ": not connecting it." << endlog();
+                    valid = false;
+                }
+            }
+
+            // connect all readers to the list of writers
+            for (vector<OutputPortInterface*>::iterator w = writers.begin(); w != writers.end(); ++w) {
+                if ( (*w)->getTypeInfo() != ti )
+                    continue;
+                TaskContext* writer_owner = writer_owners[ w - writers.begin() ];
+                for (size_t r = 0; r != readers.size(); ++r) {
+                    if ( readers[r]->getTypeInfo() != ti )
+                        continue;
+                    if ( only && writer_owner != only && reader_owners[r] != only )
+                        continue;
+                    // Don't recreate connections made by an earlier pass, unless
+                    // they were removed since.
+                    ConnectionData::Established::iterator eit =
+                        connection->established.find( std::make_pair( (base::PortInterface*)*w, (base::PortInterface*)readers[r] ) );
+                    if ( eit != connection->established.end() ) {
+                        if ( stillConnected( *w, readers[r] ) ) {
+                            ++existing;
+                            continue;
                         }
+                        connection->established.erase( eit );
+                    }
+                    if ( (*w)->connectTo( readers[r], connection->policy ) == false) {
+                        log(Error) << "Could not subscribe InputPort "<< reader_owners[r]->getName()<<"."<< readers[r]->getName() << " to topic " << (*w)->getName() <<'/'<< connection_name <<endlog();
+                        valid = false;
+                        ++failed;
+                    } else {
+                        connection->established.insert( std::make_pair( (base::PortInterface*)*w, (base::PortInterface*)readers[r] ) );
+                        ++created;
                     }
-                    ++p;
                 }
-                ++w;
-                p = connection->ports.begin();
             }
+            log(Debug) << "Topic " << connection_name << ": " << writers.size() << " writer(s), " << readers.size() << " reader(s)." << endlog();
         }
+        if ( created || failed )
+            log(Info) << "Created " << created << " data port connections for " << conmap.size() << " topics ("
+                      << existing << " already present, " << skipped << " skipped, " << failed << " failed)." << endlog();
         return valid;
     }
     
@@ -1606,6 +1760,9 @@ namespace OCL
             return false;
         }
         bool valid = true;
+        if ( autoPlacement.get() )
+            placeActivitiesGroup( group );
+        std::vector<std::string> parallel;
         for (RTT::PropertyBag::iterator it= root.begin(); it!=root.end();it++) {
 
             // only components in this group
@@ -1614,6 +1771,11 @@ namespace OCL
             }
 
             TaskContext* peer = compmap[(*it)->getName()].instance;
+            if ( !peer ) {
+                if ( compmap[(*it)->getName()].autostart )
+                    valid = false;
+                continue;
+            }
 
             // only start if not already running (peer may have been previously
             // loaded/configured/started from the site deployer file)
@@ -1623,11 +1785,22 @@ namespace OCL
             }
 
             // AutoStart
+            if ( compmap[(*it)->getName()].autostart && parallelStartStop.get() ) {
+                parallel.push_back( (*it)->getName() );
+                continue;
+            }
+            if ( compmap[(*it)->getName()].autostart && startStopBusy( (*it)->getName() ) ) {
+                log(Error) << "Can not start " << (*it)->getName() << ": its previous start() or stop() did not return yet." << endlog();
+                valid = false;
+                continue;
+            }
 	    OperationCaller<bool(void)> peerstart = peer->getOperation("start");
             if (compmap[(*it)->getName()].autostart )
                 if ( !peer || ( !peer->isRunning() && peerstart() == false) )
                     valid = false;
         }
+        if ( !parallel.empty() )
+            valid &= startStopComponentsParallel( parallel, true );
         // Finally, report success/failure:
         if (!valid) {
             for ( CompList::iterator cit = comps.begin(); cit != comps.end(); ++cit) {
@@ -1666,10 +1839,20 @@ namespace OCL
         RTT::Logger::In in("stopComponentsGroup");
         log(Info) << "Stopping group " << group << endlog();
         bool valid = true;
+        std::vector<std::string> parallel;
         // 1. Stop all activities, give components chance to cleanup.
         for ( CompList::reverse_iterator cit = comps.rbegin(); cit != comps.rend(); ++cit) {
             ComponentData* it = &(compmap[*cit]);
             if ( (group == it->group) && it->instance && !it->proxy ) {
+                if ( parallelStartStop.get() && it->instance->isRunning() ) {
+                    parallel.push_back( *cit );
+                    continue;
+                }
+                if ( startStopBusy( *cit ) ) {
+                    log(Error) << "Can not stop " << *cit << ": its previous start() or stop() did not return yet." << endlog();
+                    valid = false;
+                    continue;
+                }
                 OperationCaller<bool(void)> instancestop = it->instance->getOperation("stop");
                 if ( !it->instance->isRunning() ||
                      instancestop() ) {
@@ -1680,9 +1863,164 @@ namespace OCL
                 }
             }
         }
+        if ( !parallel.empty() )
+            valid &= startStopComponentsParallel( parallel, false );
         return valid;
     }
 
+    bool DeploymentComponent::startStopComponentsParallel(const std::vector<std::string>& names, bool start)
+    {
+        const char* what = start ? "start" : "stop";
+        bool valid = true;
+        std::set<std::string> pending( names.begin(), names.end() );
+        // components which failed, timed out or were skipped: they block
+        // the components which would have to wait for them.
+        std::set<std::string> failed;
+
+        while ( !pending.empty() ) {
+            // Collect the next wave: all pending components whose ordering
+            // constraints towards other pending components are satisfied.
+            // Those which have to wait for a failed component are skipped.
+            std::vector<std::string> wave;
+            bool skipped = false;
+            for (std::vector<std::string>::const_iterator n = names.begin(); n != names.end(); ++n) {
+                if ( pending.count( *n ) == 0 )
+                    continue;
+                bool ready = true;
+                std::string blocker;
+                if ( start ) {
+                    // all our dependencies must have been started.
+                    std::vector<std::string>& deps = compmap[*n].dependencies;
+                    for (std::vector<std::string>::iterator d = deps.begin(); blocker.empty() && d != deps.end(); ++d) {
+                        if ( failed.count( *d ) )
+                            blocker = *d;
+                        else if ( pending.count( *d ) )
+                            ready = false;
+                    }
+                } else {
+                    // all components depending on us must have been stopped.
+                    for (std::vector<std::string>::const_iterator o = names.begin(); blocker.empty() && o != names.end(); ++o) {
+                        if ( pending.count( *o ) == 0 && failed.count( *o ) == 0 )
+                            continue;
+                        std::vector<std::string>& deps = compmap[*o].dependencies;
+                        if ( std::find( deps.begin(), deps.end(), *n ) == deps.end() )
+                            continue;
+                        if ( failed.count( *o ) )
+                            blocker = *o;
+                        else
+                            ready = false;
+                    }
+                }
+                if ( !blocker.empty() ) {
+                    log(Error) << "Not trying to " << what << " " << *n << ": " << blocker << " did not " << what << "." << endlog();
+                    pending.erase( *n );
+                    failed.insert( *n );
+                    valid = false;
+                    skipped = true;
+                } else if ( ready )
+                    wave.push_back( *n );
+            }
+
+            if ( wave.empty() && skipped )
+                continue;
+            if ( wave.empty() ) {
+                log(Error) << "Circular DependsOn relation between components:";
+                for (std::set<std::string>::iterator o = pending.begin(); o != pending.end(); ++o)
+                    log(Error) << " " << *o;
+                log(Error) << ". Not trying to " << what << " these." << endlog();
+                return false;
+            }
+
+            // Launch one job per component of this wave.
+            std::vector<StartStopJob*> jobs;
+            std::vector<RTT::Activity*> acts;
+            std::vector<std::string>::iterator n = wave.begin();
+            while ( n != wave.end() ) {
+                pending.erase( *n );
+                if ( startStopBusy( *n ) ) {
+                    log(Error) << "Can not " << what << " " << *n << ": its previous start() or stop() did not return yet." << endlog();
+                    failed.insert( *n );
+                    valid = false;
+                    n = wave.erase( n );
+                    continue;
+                }
+                StartStopJob* job = new StartStopJob( compmap[*n].instance, start );
+                RTT::Activity* act = new RTT::Activity( ORO_SCHED_OTHER, RTT::os::LowestPriority, 0.0, job, *n + "." + what );
+                jobs.push_back( job );
+                acts.push_back( act );
+                act->start();
+                ++n;
+            }
+
+            // Wait for each job within its own timeout.
+            os::TimeService::ticks wave_start = os::TimeService::Instance()->getTicks();
+            TIME_SPEC ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = 1000000;
+            for (unsigned int i = 0; i != jobs.size(); ++i) {
+                double timeout = compmap[ wave[i] ].startstop_timeout;
+                if ( timeout <= 0.0 )
+                    timeout = startStopTimeout.get();
+                while ( !jobs[i]->isFinished() && os::TimeService::Instance()->secondsSince( wave_start ) < timeout )
+                    rtos_nanosleep(&ts, 0);
+
+                if ( !jobs[i]->isFinished() ) {
+                    // We can not abort a running hook: keep the job, it still
+                    // uses the component, and delete it once it has returned.
+                    log(Error) << "Timed out after " << timeout << "s waiting for " << what << "() of " << wave[i] << endlog();
+                    failed.insert( wave[i] );
+                    valid = false;
+                    compmap[ wave[i] ].startstop_job = jobs[i];
+                    compmap[ wave[i] ].startstop_act = acts[i];
+                    continue;
+                }
+                if ( jobs[i]->getResult() ) {
+                    log(Info) << (start ? "Started " : "Stopped ") << wave[i] << endlog();
+                } else {
+                    log(Error) << "Could not " << what << " loaded Component " << wave[i] << endlog();
+                    failed.insert( wave[i] );
+                    valid = false;
+                }
+                acts[i]->stop();
+                delete acts[i];
+                delete jobs[i];
+            }
+        }
+        return valid;
+    }
+
+    bool DeploymentComponent::startStopBusy(const std::string& name)
+    {
+        CompMap::iterator it = compmap.find( name );
+        if ( it == compmap.end() || it->second.startstop_job == 0 )
+            return false;
+        if ( !it->second.startstop_job->isFinished() )
+            return true;
+        it->second.startstop_act->stop();
+        delete it->second.startstop_act;
+        delete it->second.startstop_job;
+        it->second.startstop_act = 0;
+        it->second.startstop_job = 0;
+        return false;
+    }
+
+    bool DeploymentComponent::addDependency(const std::string& comp_name, const std::string& depends_on)
+    {
+        RTT::Logger::In in("addDependency");
+        if ( comp_name == depends_on ) {
+            log(Error) << "Component " << comp_name << " can not depend on itself." << endlog();
+            return false;
+        }
+        if ( compmap.count( comp_name ) == 0 && this->getPeer( comp_name ) == 0 ) {
+            log(Error) << "Can't add dependency: component " << comp_name << " not found." << endlog();
+            return false;
+        }
+        std::vector<std::string>& deps = compmap[comp_name].dependencies;
+        if ( std::find( deps.begin(), deps.end(), depends_on ) == deps.end() )
+            deps.push_back( depends_on );
+        return true;
+    }
+
     bool DeploymentComponent::cleanupComponents()
     {
         // do all groups
@@ -1708,7 +2046,10 @@ namespace OCL
             }
 
             if (it->instance && !it->proxy) {
-                if ( it->instance->getTaskState() <= base::TaskCore::Stopped ) {
+                if ( startStopBusy( *cit ) ) {
+                    log(Error) << "Could not cleanup Component "<< it->instance->getName() << " (start() or stop() still running)"<<endlog();
+                    valid = false;
+                } else if ( it->instance->getTaskState() <= base::TaskCore::Stopped ) {
                     if ( it->autosave && !it->configfile.empty()) {
                         if (it->loadedProperties) {
                             string file = it->configfile; // get file name
@@ -1821,6 +2162,20 @@ namespace OCL
         return PluginLoader::Instance()->loadService(type, peer);
     }
 
+    bool DeploymentComponent::loadServiceInComponents(const std::string& service) {
+        RTT::Logger::In in("loadServiceInComponents");
+        bool valid = true;
+        for (CompMap::iterator cit = compmap.begin(); cit != compmap.end(); ++cit) {
+            if ( !cit->second.instance || cit->second.proxy )
+                continue;
+            if ( !this->loadService( cit->first, service ) ) {
+                log(Error) << "Could not load service '"<< service <<"' in "<< cit->first <<endlog();
+                valid = false;
+            }
+        }
+        return valid;
+    }
+
     // or type is a shared library or it is a class type.
     bool DeploymentComponent::loadComponent(const std::string& name, const std::string& type)
     {
@@ -1860,6 +2215,235 @@ namespace OCL
         return true;
     }
 
+    bool DeploymentComponent::hotSwapComponent(const std::string& name, const std::string& type)
+    {
+        RTT::Logger::In in("hotSwapComponent");
+
+        if ( compmap.count( name ) == 0 || compmap[name].loaded == false || compmap[name].instance == 0 ) {
+            log(Error) << "Can't hot-swap component '"<<name<<"': not loaded by "<<this->getName()<<endlog();
+            return false;
+        }
+        ComponentData& cd = compmap[name];
+        if ( cd.proxy ) {
+            log(Error) << "Can't hot-swap component '"<<name<<"': it is a proxy."<<endlog();
+            return false;
+        }
+        if ( startStopBusy( name ) ) {
+            log(Error) << "Can't hot-swap component '"<<name<<"': its start() or stop() did not return yet."<<endlog();
+            return false;
+        }
+        TaskContext* old = cd.instance;
+
+        FactoryMap::const_iterator fit = getFactories().find( type );
+        if ( fit == getFactories().end() ) {
+            log(Error) << "Can't hot-swap component '"<<name<<"': unknown component type '"<<type<<"'."<<endlog();
+            return false;
+        }
+
+        // Only these activities can be duplicated, a FileDescriptorActivity
+        // (which is an Activity too) would lose its file descriptors.
+        base::ActivityInterface* oact = old->getActivity();
+        bool is_activity = oact && dynamic_cast<RTT::Activity*>( oact ) && !dynamic_cast<RTT::extras::FileDescriptorActivity*>( oact );
+        bool is_sequential = oact && dynamic_cast<SequentialActivity*>( oact );
+        if ( oact && !is_activity && !is_sequential ) {
+            log(Error) << "Can't hot-swap component '"<<name<<"': its type of activity can not be duplicated."<<endlog();
+            return false;
+        }
+
+        // 1. Create the new instance next to the old one. It is only announced
+        // with componentLoaded() once the old one is unannounced, since both
+        // have the same name.
+        TaskContext* fresh = 0;
+        try {
+            fresh = (fit->second)( name );
+        } catch (...) {
+            log(Error) << "The constructor of component type "<<type<<" threw an exception!"<<endlog();
+        }
+        if ( !fresh )
+            return false;
+
+        // 2. Transfer matching properties and duplicate the activity.
+        refreshProperties( *fresh->properties(), *old->properties(), false );
+        if ( is_activity ) {
+            fresh->setActivity( new RTT::Activity( oact->thread()->getScheduler(), oact->thread()->getPriority(),
+                                                   oact->getPeriod(), oact->thread()->getCpuAffinity(), 0, name ) );
+            fresh->getActivity()->thread()->setWaitPeriodPolicy( cd.wait_policy );
+        } else if ( is_sequential ) {
+            fresh->setActivity( new SequentialActivity() );
+        }
+
+        // 3. Configure it if the old one was configured, such that ports
+        // created in configureHook() exist.
+        if ( old->getTaskState() >= base::TaskCore::Stopped ) {
+            OperationCaller<bool(void)> freshconfigure = fresh->getOperation("configure");
+            if ( !freshconfigure() ) {
+                log(Error) << "New instance of "<< name <<" returns false in configure(): aborting hot-swap."<<endlog();
+                delete fresh;
+                return false;
+            }
+        }
+
+        // 4. Every port of the old instance listed in the conmap must exist in the new one.
+        for( ConMap::iterator cmit = conmap.begin(); cmit != conmap.end(); ++cmit) {
+            for (size_t n = 0; n != cmit->second.owners.size(); ++n) {
+                if ( cmit->second.owners[n] == old && fresh->ports()->getPort( cmit->second.ports[n]->getName() ) == 0 ) {
+                    log(Error) << "New instance of "<< name <<" has no port '"<< cmit->second.ports[n]->getName()
+                               << "' for connection "<< cmit->first <<": aborting hot-swap."<<endlog();
+                    delete fresh;
+                    return false;
+                }
+            }
+        }
+
+        // 5. Move the connections: replace the old ports in the conmap and
+        // connect the new ones while the old instance keeps running. The
+        // topics are saved first, to restore them if the hot-swap is aborted.
+        ConMap saved;
+        for( ConMap::iterator cmit = conmap.begin(); cmit != conmap.end(); ++cmit) {
+            for (size_t n = 0; n != cmit->second.owners.size(); ++n) {
+                if ( cmit->second.owners[n] != old )
+                    continue;
+                if ( saved.count( cmit->first ) == 0 )
+                    saved[ cmit->first ] = cmit->second;
+                base::PortInterface* oport = cmit->second.ports[n];
+                ConnectionData::Established::iterator eit = cmit->second.established.begin();
+                while ( eit != cmit->second.established.end() ) {
+                    if ( eit->first == oport || eit->second == oport )
+                        cmit->second.established.erase( eit++ );
+                    else
+                        ++eit;
+                }
+                cmit->second.ports[n] = fresh->ports()->getPort( oport->getName() );
+                cmit->second.owners[n] = fresh;
+            }
+        }
+        PeerRefs repointed;
+        if ( !createDataPortConnections( false, fresh ) ) {
+            log(Error) << "Could not connect the new instance of "<< name <<": aborting hot-swap."<<endlog();
+            undoHotSwap( name, old, fresh, saved, repointed, false );
+            return false;
+        }
+
+        // 6. Repoint the peer references.
+        TaskContext::PeerList opeers = old->getPeerList();
+        for (TaskContext::PeerList::iterator pit = opeers.begin(); pit != opeers.end(); ++pit)
+            fresh->addPeer( old->getPeer( *pit ), *pit );
+        for (CompMap::iterator cit = compmap.begin(); cit != compmap.end(); ++cit) {
+            TaskContext* user = cit->second.instance;
+            if ( !user || user == old )
+                continue;
+            TaskContext::PeerList upeers = user->getPeerList();
+            for (TaskContext::PeerList::iterator pit = upeers.begin(); pit != upeers.end(); ++pit) {
+                if ( user->getPeer( *pit ) == old ) {
+                    user->removePeer( *pit );
+                    user->addPeer( fresh, *pit );
+                    repointed.push_back( std::make_pair( user, *pit ) );
+                }
+            }
+        }
+        this->removePeer( name );
+        this->addPeer( fresh, name );
+        repointed.push_back( std::make_pair( (TaskContext*)this, name ) );
+        cd.instance = fresh;
+
+        // 7. Announce the new instance in place of the old one.
+        this->componentUnloaded( old );
+        if ( !this->componentLoaded( fresh ) ) {
+            log(Error) << "This deployer type refused to connect to the new instance of "<< name << ": aborting hot-swap." << endlog();
+            if ( !this->componentLoaded( old ) )
+                log(Error) << "This deployer type refused to connect to the old instance of "<< name << " again." << endlog();
+            undoHotSwap( name, old, fresh, saved, repointed, false );
+            return false;
+        }
+
+        // 8. Swap execution: stop the old instance and start the new one right after.
+        if ( old->isRunning() ) {
+            OperationCaller<bool(void)> oldstop = old->getOperation("stop");
+            OperationCaller<bool(void)> oldstart = old->getOperation("start");
+            OperationCaller<bool(void)> freshstart = fresh->getOperation("start");
+            if ( !oldstop() ) {
+                log(Error) << "Old instance of "<< name <<" could not be stopped: aborting hot-swap."<<endlog();
+                undoHotSwap( name, old, fresh, saved, repointed, true );
+                return false;
+            }
+            if ( !freshstart() ) {
+                log(Error) << "New instance of "<< name <<" could not be started: aborting hot-swap."<<endlog();
+                undoHotSwap( name, old, fresh, saved, repointed, true );
+                if ( !oldstart() )
+                    log(Error) << "Old instance of "<< name <<" could not be started again."<<endlog();
+                return false;
+            }
+        }
+
+        // 9. Destroy the old instance and move the service and operation bindings.
+        old->disconnect();
+        if ( cd.hotswapped )
+            delete old;
+        else
+            ComponentLoader::Instance()->unloadComponent( old );
+        cd.hotswapped = true;
+        if ( !moveBindings( name ) )
+            log(Error) << "Not all services and operations of "<< name <<" could be bound to the new instance."<<endlog();
+
+        log(Info) << "Hot-swapped component "<< name <<" with a new instance of type "<< type <<"."<<endlog();
+        return true;
+    }
+
+    void DeploymentComponent::undoHotSwap(const std::string& name, TaskContext* old, TaskContext* fresh,
+                                          const ConMap& saved, const PeerRefs& repointed, bool announced)
+    {
+        if ( announced )
+            this->componentUnloaded( fresh );
+        // disconnects the ports of fresh and removes it from its users.
+        fresh->disconnect();
+        for (PeerRefs::const_iterator pit = repointed.begin(); pit != repointed.end(); ++pit)
+            pit->first->addPeer( old, pit->second );
+        for (ConMap::const_iterator cmit = saved.begin(); cmit != saved.end(); ++cmit)
+            conmap[ cmit->first ] = cmit->second;
+        compmap[name].instance = old;
+        if ( announced && !this->componentLoaded( old ) )
+            log(Error) << "This deployer type refused to connect to the old instance of "<< name << " again." << endlog();
+        delete fresh;
+    }
+
+    bool DeploymentComponent::moveBindings(const std::string& name)
+    {
+        bool valid = true;
+        TaskContext* fresh = compmap[name].instance;
+        for (Bindings::const_iterator b = service_bindings.begin(); b != service_bindings.end(); ++b) {
+            if ( b->first != name && b->second != name )
+                continue;
+            TaskContext* other = getPeer( b->first == name ? b->second : b->first );
+            if ( !other ) {
+                log(Error) << "Can't connect the services of "<< name <<" again: "<< (b->first == name ? b->second : b->first) <<" is gone."<<endlog();
+                valid = false;
+                continue;
+            }
+            // the required services of the other side still refer to the old instance.
+            std::vector<std::string> reqs = other->requires()->getRequesterNames();
+            for (std::vector<std::string>::iterator r = reqs.begin(); r != reqs.end(); ++r)
+                if ( fresh->provides()->hasService( *r ) )
+                    other->requires( *r )->disconnect();
+            TaskContext* one = b->first == name ? fresh : other;
+            valid = one->connectServices( one == fresh ? other : fresh ) && valid;
+        }
+        Bindings operations = operation_bindings;
+        for (Bindings::const_iterator b = operations.begin(); b != operations.end(); ++b) {
+            if ( bindingComponent( b->first ) != name && bindingComponent( b->second ) != name )
+                continue;
+            // a required operation of another component still refers to the old instance.
+            if ( bindingComponent( b->first ) != name ) {
+                std::string::size_type dot = b->first.rfind('.');
+                ServiceRequester::shared_ptr r = stringToServiceRequester( b->first.substr( 0, dot ) );
+                RTT::base::OperationCallerBaseInvoker* rop = r ? r->getOperationCaller( b->first.substr( dot + 1 ) ) : 0;
+                if ( rop )
+                    rop->disconnect();
+            }
+            valid = connectOperations( b->first, b->second ) && valid;
+        }
+        return valid;
+    }
+
     /**
      * This method removes all references to the component hold in \a cit,
      * on the condition that it is not running.
@@ -1870,6 +2454,10 @@ namespace OCL
         ComponentData* it = &(cit->second);
         std::string  name = cit->first;
 
+        if ( startStopBusy( name ) ) {
+            log(Error) << "Could not unload Component "<< name <<": its start() or stop() did not return yet." <<endlog();
+            return false;
+        }
         if ( it->loaded && it->instance ) {
             if ( !it->instance->isRunning() ) {
                 if (!it->proxy ) {
@@ -1886,6 +2474,14 @@ namespace OCL
                     size_t n = 0;
                     while ( n != cmit->second.owners.size() ) {
                         if (cmit->second.owners[n] == it->instance ) {
+                            // forget the connections made by this port as well.
+                            ConnectionData::Established::iterator eit = cmit->second.established.begin();
+                            while ( eit != cmit->second.established.end() ) {
+                                if ( eit->first == cmit->second.ports[n] || eit->second == cmit->second.ports[n] )
+                                    cmit->second.established.erase( eit++ );
+                                else
+                                    ++eit;
+                            }
                             cmit->second.owners.erase( cmit->second.owners.begin() + n );
                             cmit->second.ports.erase( cmit->second.ports.begin() + n );
                             n = 0;
@@ -1893,6 +2489,13 @@ namespace OCL
                             ++n;
                     }
                 }
+                // and the bindings it was part of.
+                for (size_t b = service_bindings.size(); b-- != 0; )
+                    if ( service_bindings[b].first == name || service_bindings[b].second == name )
+                        service_bindings.erase( service_bindings.begin() + b );
+                for (size_t b = operation_bindings.size(); b-- != 0; )
+                    if ( bindingComponent( operation_bindings[b].first ) == name || bindingComponent( operation_bindings[b].second ) == name )
+                        operation_bindings.erase( operation_bindings.begin() + b );
                 // Lookup in the property configuration and remove:
                 RTT::Property<RTT::PropertyBag>* pcomp = root.getPropertyType<PropertyBag>(name);
                 if (pcomp) {
@@ -1902,7 +2505,10 @@ namespace OCL
                 // Finally, delete the activity before the TC !
                 delete it->act;
                 it->act = 0;
-                ComponentLoader::Instance()->unloadComponent( it->instance );
+                if ( it->hotswapped )
+                    delete it->instance;
+                else
+                    ComponentLoader::Instance()->unloadComponent( it->instance );
                 it->instance = 0;
                 log(Info) << "Disconnected and destroyed "<< name <<endlog();
             } else {
@@ -2165,6 +2771,7 @@ namespace OCL
 
         // assign default wait period policy to newly created activity
         newact->thread()->setWaitPeriodPolicy(defaultWaitPeriodPolicy);
+        compmap[comp_name].wait_policy = defaultWaitPeriodPolicy;
 
         // this must never happen if component is running:
         assert( peer->isRunning() == false );
@@ -2174,6 +2781,279 @@ namespace OCL
         return true;
     }
 
+#if defined(ORO_SUPPORT_CPU_AFFINITY) && defined(__linux__)
+    /**
+     * A set of CPUs, indexed by CPU number.
+     */
+    typedef std::vector<bool> CpuSet;
+
+    /**
+     * Converts a Linux CPU list like "0-3,8" into a CpuSet.
+     */
+    static CpuSet cpulist_to_set(const std::string& list)
+    {
+        CpuSet set;
+        std::vector<std::string> ranges;
+        boost::split(ranges, list, boost::is_any_of(","));
+        for (std::vector<std::string>::iterator r = ranges.begin(); r != ranges.end(); ++r) {
+            boost::trim( *r );
+            if ( r->empty() )
+                continue;
+            std::string::size_type dash = r->find('-');
+            unsigned lo = atoi( r->substr(0, dash).c_str() );
+            unsigned hi = (dash == std::string::npos) ? lo : atoi( r->substr(dash + 1).c_str() );
+            if ( hi >= set.size() )
+                set.resize( hi + 1, false );
+            for (unsigned c = lo; c <= hi; ++c)
+                set[c] = true;
+        }
+        return set;
+    }
+
+    static unsigned count_cpus(unsigned mask)
+    {
+        unsigned n = 0;
+        for (; mask; mask &= mask - 1)
+            ++n;
+        return n;
+    }
+
+    /**
+     * The RTT affinity mask of \a set. RTT takes an unsigned mask, so
+     * CPUs beyond its width can not be selected and are left out.
+     */
+    static unsigned set_to_mask(const CpuSet& set)
+    {
+        unsigned mask = 0;
+        for (unsigned c = 0; c < set.size() && c < sizeof(unsigned) * 8; ++c)
+            if ( set[c] )
+                mask |= 1u << c;
+        return mask;
+    }
+
+    static bool read_sysfs_line(const std::string& file, std::string& line)
+    {
+        std::ifstream f( file.c_str() );
+        if ( !f || !std::getline( f, line ) )
+            return false;
+        boost::trim( line );
+        return true;
+    }
+
+    /**
+     * Groups the online CPUs by the highest level cache they share.
+     * @return one CpuSet per cache domain, or an empty list if the
+     * topology could not be read.
+     */
+    static std::vector<CpuSet> read_cache_domains()
+    {
+        std::vector<CpuSet> domains;
+        std::string online;
+        if ( !read_sysfs_line("/sys/devices/system/cpu/online", online) )
+            return domains;
+        CpuSet cpus = cpulist_to_set( online );
+        for (unsigned c = 0; c < cpus.size(); ++c) {
+            if ( !cpus[c] )
+                continue;
+            CpuSet domain( cpus.size(), false );
+            domain[c] = true;
+            int best = 0;
+            for (int idx = 0; ; ++idx) {
+                std::ostringstream base;
+                base << "/sys/devices/system/cpu/cpu" << c << "/cache/index" << idx << "/";
+                std::string level, shared;
+                if ( !read_sysfs_line( base.str() + "level", level ) || !read_sysfs_line( base.str() + "shared_cpu_list", shared ) )
+                    break;
+                int l = atoi( level.c_str() );
+                if ( l >= best ) {
+                    best = l;
+                    CpuSet sharing = cpulist_to_set( shared );
+                    for (unsigned o = 0; o < cpus.size(); ++o)
+                        domain[o] = cpus[o] && ( o == c || ( o < sharing.size() && sharing[o] ) );
+                }
+            }
+            if ( std::find( domains.begin(), domains.end(), domain ) == domains.end() )
+                domains.push_back( domain );
+        }
+        return domains;
+    }
+
+    static unsigned find_cluster(std::vector<unsigned>& parent, unsigned i)
+    {
+        while ( parent[i] != i ) {
+            parent[i] = parent[ parent[i] ];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    /**
+     * Components of placeActivitiesGroup() which communicate: the rate of
+     * the members to place, the highest priority of all members and the
+     * cache domain of the members which stay where they are, or -1.
+     */
+    struct PlacementCluster {
+        std::vector<unsigned> members;
+        double rate;
+        int priority;
+        int domain;
+    };
+
+    /**
+     * True if a thread of priority \a a is not preempted by one of \a b.
+     */
+    static bool at_least(int a, int b)
+    {
+        return RTT::os::HighestPriority > RTT::os::LowestPriority ? a >= b : a <= b;
+    }
+#endif
+
+    bool DeploymentComponent::placeActivities()
+    {
+        return placeActivitiesGroup( -1 );
+    }
+
+    bool DeploymentComponent::placeActivitiesGroup(const int group)
+    {
+        RTT::Logger::In in("placeActivities");
+#if defined(ORO_SUPPORT_CPU_AFFINITY) && defined(__linux__)
+        std::vector<CpuSet> all = read_cache_domains();
+        // only the CPUs RTT can address, see set_to_mask().
+        std::vector<unsigned> masks;
+        unsigned allcpus = 0;
+        for (size_t d = 0; d != all.size(); ++d) {
+            unsigned mask = set_to_mask( all[d] );
+            if ( mask == 0 ) {
+                log(Warning) << "Not using cache domain " << d << ": its CPUs are beyond the CPU affinity mask of RTT." << endlog();
+                continue;
+            }
+            if ( all[d].size() > sizeof(unsigned) * 8 && std::find( all[d].begin() + sizeof(unsigned) * 8, all[d].end(), true ) != all[d].end() )
+                log(Warning) << "Cache domain " << d << " has CPUs beyond the CPU affinity mask of RTT, which are not used." << endlog();
+            masks.push_back( mask );
+            allcpus |= mask;
+        }
+        if ( masks.empty() ) {
+            log(Error) << "Could not read the CPU topology from /sys/devices/system/cpu." << endlog();
+            return false;
+        }
+
+        // 1. Collect the periodic real-time activities we may place. Running
+        // ones and those of other groups are not moved, but are kept together
+        // with the components they communicate with.
+        std::vector<std::string> names;
+        std::vector<bool> movable;
+        std::map<TaskContext*, unsigned> index;
+        for (CompMap::iterator cit = compmap.begin(); cit != compmap.end(); ++cit) {
+            TaskContext* tc = cit->second.instance;
+            if ( !tc || cit->second.proxy )
+                continue;
+            RTT::Activity* act = dynamic_cast<RTT::Activity*>( tc->getActivity() );
+            if ( !act || act->getPeriod() == 0.0 || act->thread()->getScheduler() != ORO_SCHED_RT )
+                continue;
+            if ( !cit->second.placed && (act->thread()->getCpuAffinity() & allcpus) != allcpus ) {
+                log(Info) << "Keeping the explicit CPU affinity of " << cit->first << "." << endlog();
+                continue;
+            }
+            index[tc] = names.size();
+            names.push_back( cit->first );
+            movable.push_back( (group == -1 || cit->second.group == group) && !tc->isRunning() );
+        }
+        if ( std::find( movable.begin(), movable.end(), true ) == movable.end() ) {
+            log(Info) << "No periodic real-time activities to place." << endlog();
+            return true;
+        }
+
+        // 2. Components connected through the conmap form one cluster.
+        std::vector<unsigned> parent( names.size() );
+        for (unsigned i = 0; i != parent.size(); ++i)
+            parent[i] = i;
+        for (ConMap::iterator cmit = conmap.begin(); cmit != conmap.end(); ++cmit) {
+            int first = -1;
+            for (size_t n = 0; n != cmit->second.owners.size(); ++n) {
+                std::map<TaskContext*, unsigned>::iterator ix = index.find( cmit->second.owners[n] );
+                if ( ix == index.end() )
+                    continue;
+                if ( first == -1 )
+                    first = ix->second;
+                else
+                    parent[ find_cluster( parent, ix->second ) ] = find_cluster( parent, first );
+            }
+        }
+
+        std::map<unsigned, PlacementCluster> clusters;
+        // per domain: the rate and priority of the threads already on it.
+        std::vector<std::vector<std::pair<int, double> > > fixed( masks.size() );
+        for (unsigned i = 0; i != names.size(); ++i) {
+            base::ActivityInterface* act = compmap[ names[i] ].instance->getActivity();
+            unsigned root = find_cluster( parent, i );
+            PlacementCluster& c = clusters[root];
+            if ( c.members.empty() ) {
+                c.rate = 0.0;
+                c.priority = act->thread()->getPriority();
+                c.domain = -1;
+            }
+            c.members.push_back( i );
+            if ( !at_least( c.priority, act->thread()->getPriority() ) )
+                c.priority = act->thread()->getPriority();
+            if ( movable[i] ) {
+                c.rate += 1.0 / act->getPeriod();
+                continue;
+            }
+            std::vector<unsigned>::iterator m = std::find( masks.begin(), masks.end(), act->thread()->getCpuAffinity() );
+            if ( m != masks.end() ) {
+                c.domain = m - masks.begin();
+                fixed[ c.domain ].push_back( std::make_pair( act->thread()->getPriority(), 1.0 / act->getPeriod() ) );
+            }
+        }
+
+        // 3. Assign clusters by priority band, highest first, and within a band
+        // the busiest first. A domain's load for a cluster is the rate of the
+        // threads on it which the cluster can not preempt.
+        std::vector<std::pair<std::pair<int, double>, unsigned> > order;
+        int rank = RTT::os::HighestPriority > RTT::os::LowestPriority ? 1 : -1;
+        for (std::map<unsigned, PlacementCluster>::iterator c = clusters.begin(); c != clusters.end(); ++c)
+            if ( c->second.rate > 0.0 )
+                order.push_back( std::make_pair( std::make_pair( rank * c->second.priority, c->second.rate ), c->first ) );
+        std::sort( order.rbegin(), order.rend() );
+        for (size_t o = 0; o != order.size(); ++o) {
+            PlacementCluster& c = clusters[ order[o].second ];
+            size_t best = c.domain;
+            if ( c.domain == -1 ) {
+                std::vector<double> load( masks.size(), 0.0 );
+                for (size_t d = 0; d != masks.size(); ++d) {
+                    for (size_t f = 0; f != fixed[d].size(); ++f)
+                        if ( at_least( fixed[d][f].first, c.priority ) )
+                            load[d] += fixed[d][f].second;
+                    load[d] /= count_cpus( masks[d] );
+                }
+                best = std::min_element( load.begin(), load.end() ) - load.begin();
+            }
+            fixed[best].push_back( std::make_pair( c.priority, c.rate ) );
+            for (size_t m = 0; m != c.members.size(); ++m) {
+                if ( !movable[ c.members[m] ] )
+                    continue;
+                const std::string& name = names[ c.members[m] ];
+                ComponentData& cd = compmap[ name ];
+                base::ActivityInterface* act = cd.instance->getActivity();
+                if ( !act->thread()->setCpuAffinity( masks[best] ) ) {
+                    log(Warning) << "Failed to set the CPU affinity of " << name << "." << endlog();
+                    continue;
+                }
+                cd.placed = true;
+                std::ostringstream mask;
+                mask << "0x" << std::hex << masks[best];
+                log(Info) << "Placed " << name << " (period " << act->getPeriod()
+                          << "s, priority " << act->thread()->getPriority() << ") on CPU mask "
+                          << mask.str() << " (cache domain " << best << ")." << endlog();
+            }
+        }
+        return true;
+#else
+        log(Warning) << "Automatic activity placement is not supported on this platform." << endlog();
+        return false;
+#endif
+    }
+
     bool DeploymentComponent::setWaitPeriodPolicy(const std::string& comp_name, int policy)
     {
         if ( !compmap.count(comp_name) ) {
@@ -2188,6 +3068,7 @@ namespace OCL
         }
 
         activity->thread()->setWaitPeriodPolicy(policy);
+        compmap[comp_name].wait_policy = policy;
         return true;
     }
 
@@ -2251,6 +3132,11 @@ namespace OCL
         bool valid = true;
         // 1. Cleanup a single activities, give components chance to cleanup.
         if (instance) {
+            for (CompMap::iterator cit = compmap.begin(); cit != compmap.end(); ++cit)
+                if ( cit->second.instance == instance && startStopBusy( cit->first ) ) {
+                    log(Error) << "Could not cleanup Component "<< instance->getName() << " (start() or stop() still running)"<<endlog();
+                    return false;
+                }
             if ( instance->getTaskState() <= base::TaskCore::Stopped ) {
 		OperationCaller<bool(void)> instancecleanup = instance->getOperation("cleanup");
 		instancecleanup();
@@ -38,6 +38,7 @@
 #include <ocl/OCL.hpp>
 #include <vector>
 #include <map>
+#include <set>
 #include <rtt/marsh/PropertyDemarshaller.hpp>
 
 // Suppress warnings in ocl/Component.hpp
@@ -51,6 +52,7 @@
 
 namespace OCL
 {
+    class StartStopJob;
 
     /**
      * A Component for deploying (configuring) other components in an
@@ -95,6 +97,9 @@ namespace OCL
         std::string compPath;
         int defaultWaitPeriodPolicy;
         RTT::Property<bool> autoUnload;
+        RTT::Property<bool> parallelStartStop;
+        RTT::Property<double> startStopTimeout;
+        RTT::Property<bool> autoPlacement;
         RTT::Attribute<bool> validConfig;
         RTT::Constant<int> sched_RT;
         RTT::Constant<int> sched_OTHER;
@@ -115,9 +120,11 @@ namespace OCL
                   autostart(false), autoconf(false),
                   autoconnect(false),  autosave(false),
                   proxy(false), server(false),
-                  use_naming(true),
+                  use_naming(true), hotswapped(false), placed(false),
                   configfile(""),
-                  group(0)
+                  group(0), startstop_timeout(0.0),
+                  startstop_job(0), startstop_act(0),
+                  wait_policy(ORO_WAIT_ABS)
             {}
             /**
              * The component instance. This is always a valid pointer.
@@ -141,10 +148,46 @@ namespace OCL
             bool loadedProperties;
             bool autostart, autoconf, autoconnect, autosave;
             bool proxy, server, use_naming;
+            /**
+             * True if the instance was created by hotSwapComponent()
+             * from its factory. Such an instance is not known to the
+             * ComponentLoader and must be deleted by us.
+             */
+            bool hotswapped;
+            /**
+             * True if the CPU affinity of the activity was chosen by
+             * placeActivities(), and may thus be changed again by it.
+             */
+            bool placed;
             std::string configfile;
             std::vector<std::string> plugins;
             /// Group number this component belongs to
             int group;
+            /**
+             * Components which must be started before this one and
+             * may only be stopped after this one (see DependsOn).
+             * Only used when starting or stopping in parallel.
+             */
+            std::vector<std::string> dependencies;
+            /**
+             * Maximum time in seconds start() or stop() may take when
+             * starting or stopping in parallel. Zero means: use the
+             * StartStopTimeout property of the deployer.
+             */
+            double startstop_timeout;
+            /**
+             * A start() or stop() which did not return within its
+             * timeout and is still running in startstop_act. Until it
+             * returns, the component is not started, stopped, cleaned
+             * up or unloaded again.
+             */
+            StartStopJob* startstop_job;
+            base::ActivityInterface* startstop_act;
+            /**
+             * The wait period policy of the thread of the activity,
+             * as set by setActivity() or setWaitPeriodPolicy().
+             */
+            int wait_policy;
         };
 
         /**
@@ -153,9 +196,17 @@ namespace OCL
         struct ConnectionData {
             typedef std::vector<RTT::base::PortInterface*> Ports;
             typedef std::vector<RTT::TaskContext*>   Owners;
+            /**
+             * (writer, reader) pairs which were connected by
+             * createDataPortConnections(). A stream is stored with
+             * a null reader. A pair whose connection was removed
+             * since, e.g. with disconnect(), is connected again.
+             */
+            typedef std::set<std::pair<RTT::base::PortInterface*, RTT::base::PortInterface*> > Established;
             Ports ports;
             Owners owners;
             RTT::ConnPolicy policy;
+            Established established;
         };
 
         /**
@@ -164,6 +215,15 @@ namespace OCL
         typedef std::map<std::string, ConnectionData> ConMap;
         ConMap conmap;
 
+        /**
+         * The arguments of the successful connectServices() and
+         * connectOperations() calls. hotSwapComponent() makes these
+         * bindings again for the new instance.
+         */
+        typedef std::vector<std::pair<std::string, std::string> > Bindings;
+        Bindings service_bindings;
+        Bindings operation_bindings;
+
         /**
          * This list and map hold the dynamically loaded components.
          */
@@ -231,6 +291,52 @@ namespace OCL
          */
         base::PortInterface* stringToPort(std::string const& names);
 
+        /**
+         * Starts or stops the components in \a names concurrently, each
+         * in a thread of its own. Components are started in waves: a
+         * component is only started after all components it depends on
+         * (see ComponentData::dependencies) and which are listed in
+         * \a names have been started. Stopping happens in the reverse
+         * order of these dependencies. A component which failed or timed
+         * out blocks the components which wait for it: they are skipped.
+         *
+         * @param names The components to start or stop, in the order
+         * in which they would be processed serially.
+         * @param start true to call start(), false to call stop().
+         * @return true if all components changed state within their timeout.
+         */
+        bool startStopComponentsParallel(const std::vector<std::string>& names, bool start);
+
+        /**
+         * Deletes the timed out start() or stop() job of component
+         * \a name if it has returned in the mean time.
+         * @return true if such a job is still running.
+         */
+        bool startStopBusy(const std::string& name);
+
+        /**
+         * The peer references which hotSwapComponent() moved from
+         * the old to the new instance, as (user, peer name) pairs.
+         */
+        typedef std::vector<std::pair<RTT::TaskContext*, std::string> > PeerRefs;
+
+        /**
+         * Undoes an aborted hotSwapComponent(): puts \a old back in place
+         * of \a fresh in the \a saved topics of the conmap and in the
+         * \a repointed peer references, and deletes \a fresh.
+         * @param announced true if \a fresh was announced with
+         * componentLoaded() instead of \a old.
+         */
+        void undoHotSwap(const std::string& name, RTT::TaskContext* old, RTT::TaskContext* fresh,
+                         const ConMap& saved, const PeerRefs& repointed, bool announced);
+
+        /**
+         * Makes the service_bindings and operation_bindings of
+         * component \a name again, after it was hot-swapped.
+         * @return true if all bindings could be made.
+         */
+        bool moveBindings(const std::string& name);
+
         /**
          * Waits for any signal and then returns.
          * @return false if this function could not install a signal handler.
@@ -310,7 +416,9 @@ namespace OCL
         /**
          * Create data connections for all known connections in the conmap.
          * This can be run multiple times, and it will only try to create any
-         * data connections that don't already exist.
+         * data connections that don't already exist. The ports of each
+         * connection are type-checked once, and the created connections
+         * are reported as a single summary instead of one log line each.
          *
          * @param skipUnconnected Whether to skip connections that have only
          * one port. This may occur when the port for one side of a connection
@@ -318,11 +426,13 @@ namespace OCL
          * process (e.g. by a component that dynamically creates ports in its
          * configureHook() ). If skipUnconnected==false then a connection with
          * only one port will attempt to create a stream for the connection.
+         * @param only If not null, only the connections of the ports of this
+         * component are created.
          *
          * @return true if all connections have an output port and all port
          * connections were made succesfully.
          */
-        bool createDataPortConnections(const bool skipUnconnected);
+        bool createDataPortConnections(const bool skipUnconnected, RTT::TaskContext* only = 0);
 
         using TaskContext::connectPorts;
         /**
@@ -482,6 +592,40 @@ namespace OCL
          */
         bool reloadLibrary(const std::string& filepath);
 
+        /**
+         * Replace a loaded component by a new instance of \a type, without
+         * tearing down its data flow connections. The new instance is created
+         * next to the old one, receives the old instance's property values and
+         * activity, and is configured if the old one was. Then the
+         * connections listed in the deployment configuration and all peer
+         * references are moved to the new instance, which is announced with
+         * componentLoaded(). The old instance is stopped and the new one
+         * started right after it, such that at most one execution cycle is
+         * lost. Finally the old instance is destroyed and the bindings made
+         * with connectServices() and connectOperations() are made again for
+         * the new instance. Only an Activity or a SequentialActivity can be
+         * duplicated.
+         *
+         * If a step fails before the new instance runs, the hot-swap is
+         * aborted: the old instance keeps its connections, peers and state,
+         * and the new instance is deleted.
+         *
+         * @note Only connections made by the DeploymentComponent from the
+         * <Ports> tags, connectServices() and connectOperations() are moved.
+         * Connections created otherwise, for example with connect() or stream(),
+         * and OperationCallers which other components bound themselves to the
+         * old instance must be re-created by the caller.
+         *
+         * @param name The name of a component loaded with loadComponent().
+         * @param type The component type of the new instance. This type must be
+         * known to the ComponentLoader, for example after reloadLibrary() or import().
+         *
+         * @return true if the new instance took over, false if the hot-swap
+         * was aborted. Bindings which could not be made again after the new
+         * instance took over are logged as errors.
+         */
+        bool hotSwapComponent(const std::string& name, const std::string& type);
+
         /**
          * Load a new component in the current process. It wil appear
          * as a peer with name \a name of this component.
@@ -511,6 +655,17 @@ namespace OCL
          */
         bool loadService(const std::string& component, const std::string& service);
 
+        /**
+         * Loads a service in all components known to this deployer,
+         * for example the 'timing' service to monitor the execution time
+         * of the whole deployment.
+         *
+         * @param service A service discovered by the PluginLoader.
+         * @return true if the service could be loaded in all components.
+         * @see loadService()
+         */
+        bool loadServiceInComponents(const std::string& service);
+
         /**
          * Unload a loaded component from the current process. It may not
          * be running.
@@ -669,6 +824,35 @@ namespace OCL
                          int scheduler, unsigned cpu_affinity,
                          const std::string& master_name = "");
 
+        /**
+         * Choose the CPU affinity of periodic, real-time activities
+         * automatically. The CPUs are grouped by the last level cache they
+         * share, as found in /sys/devices/system/cpu. Components which
+         * exchange data through the connections of the deployment
+         * configuration are kept in the same cache domain, and the domains
+         * are balanced by the rate (1/period) of their components. Clusters
+         * are placed by priority, highest first, and a domain's load for a
+         * cluster only counts the threads which the cluster can not preempt.
+         *
+         * Only components with a RTT::Activity of their own, a non-zero
+         * period and the ORO_SCHED_RT scheduler are placed. Activities
+         * which were given a CPU affinity explicitly, running components,
+         * priorities and schedulers are left untouched. A cluster with a
+         * running member is placed in the domain of that member. The
+         * chosen placement is logged.
+         *
+         * @return false if the platform does not support CPU affinity or
+         * the CPU topology could not be read.
+         */
+        bool placeActivities();
+
+        /**
+         * Like placeActivities(), but only places the components of
+         * \a group, or of all groups if it is -1. The placed components
+         * of other groups are taken into account.
+         */
+        bool placeActivitiesGroup(const int group);
+
         /**
          * (Re-)set the wait period policy of a component's thread.
          *
@@ -757,11 +941,26 @@ namespace OCL
         bool startComponents();
         /**
          * Start all components in group \a group which have AutoStart
-         * set to true.
+         * set to true. If the ParallelStartStop property is true, components
+         * which do not depend on each other are started concurrently.
+         * If the AutoPlacement property is true, placeActivities() is called first.
          * @return true if all the group's components could be succesfully started.
          */
         bool startComponentsGroup(const int group);
 
+        /**
+         * Declare that component \a comp_name may only be started after
+         * \a depends_on has been started, and that \a depends_on may only
+         * be stopped after \a comp_name has been stopped. This ordering is
+         * only used when the ParallelStartStop property is set; serial
+         * start and stop follow the order of the configuration file.
+         *
+         * @param comp_name The dependent component.
+         * @param depends_on The component \a comp_name depends on.
+         * @return false if \a comp_name is not known to this deployer.
+         */
+        bool addDependency(const std::string& comp_name, const std::string& depends_on);
+
         /**
          * Clear all loaded configuration options.
          * This does not alter any component.
@@ -774,6 +973,8 @@ namespace OCL
         bool stopComponents();
         /**
          * Stop all loaded and running components in group \a group.
+         * If the ParallelStartStop property is true, components which do
+         * not depend on each other are stopped concurrently.
          *
          * @param group The group number to stop
          */
@@ -0,0 +1,154 @@
+#include "deployment/DeploymentComponent.hpp"
+#include <rtt/os/main.h>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/deployment/ComponentLoader.hpp>
+#include <rtt/RTT.hpp>
+#include <iostream>
+
+using namespace Orocos;
+
+static void sleepFor(double seconds)
+{
+    TIME_SPEC ts;
+    ts.tv_sec = (long) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+    rtos_nanosleep(&ts, 0);
+}
+
+class Source
+    : public RTT::TaskContext
+{
+    RTT::OutputPort<int> out;
+    int count;
+public:
+    Source(std::string n)
+        : RTT::TaskContext(n), out("out"), count(0)
+    {
+        this->ports()->addPort( out );
+    }
+    void updateHook() {
+        out.write( ++count );
+    }
+};
+
+/**
+ * Counts the samples it receives. Its version tells the instances apart.
+ */
+class Sink
+    : public RTT::TaskContext
+{
+    RTT::InputPort<int> in;
+    int mversion;
+    bool configures, starts;
+public:
+    RTT::os::AtomicInt received;
+
+    Sink(std::string n, int v, bool c = true, bool s = true)
+        : RTT::TaskContext(n), in("in"), mversion(v), configures(c), starts(s), received(0)
+    {
+        this->ports()->addPort( in );
+        this->provides("stats")->addOperation("version", &Sink::version, this);
+    }
+    int version() { return mversion; }
+    bool configureHook() { return configures; }
+    bool startHook() { return starts; }
+    void updateHook() {
+        int v;
+        while ( in.read( v ) == RTT::NewData )
+            received.inc();
+    }
+};
+
+RTT::TaskContext* createSource(std::string n) { return new Source(n); }
+RTT::TaskContext* createSink(std::string n) { return new Sink(n, 1); }
+RTT::TaskContext* createSinkV2(std::string n) { return new Sink(n, 2); }
+RTT::TaskContext* createUnconfigurableSink(std::string n) { return new Sink(n, 3, false); }
+RTT::TaskContext* createUnstartableSink(std::string n) { return new Sink(n, 4, true, false); }
+
+/**
+ * Uses the version of the Sink through a required service.
+ */
+class Monitor
+    : public RTT::TaskContext
+{
+public:
+    RTT::OperationCaller<int(void)> version;
+
+    Monitor(std::string n)
+        : RTT::TaskContext(n), version("version")
+    {
+        this->requires("stats")->addOperationCaller( version );
+    }
+};
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if ( !ok ) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static bool receives(Sink* sink)
+{
+    int before = sink->received.read();
+    sleepFor( 0.1 );
+    return sink->received.read() > before;
+}
+
+/**
+ * Hot-swaps a connected and running component, and checks that an
+ * aborted hot-swap keeps the old instance.
+ */
+int ORO_main(int, char**)
+{
+    RTT::Logger::Instance()->setLogLevel(RTT::Logger::Info);
+
+    RTT::ComponentLoader::Instance()->addFactory("HotSwapSource", &createSource);
+    RTT::ComponentLoader::Instance()->addFactory("HotSwapSink", &createSink);
+    RTT::ComponentLoader::Instance()->addFactory("HotSwapSinkV2", &createSinkV2);
+    RTT::ComponentLoader::Instance()->addFactory("HotSwapUnconfigurableSink", &createUnconfigurableSink);
+    RTT::ComponentLoader::Instance()->addFactory("HotSwapUnstartableSink", &createUnstartableSink);
+
+    Monitor monitor("Monitor");
+    {
+        DeploymentComponent dc;
+        dc.addPeer( &monitor );
+
+        check( dc.loadComponents("hotswap.cpf"), "loading hotswap.cpf" );
+        check( dc.configureComponents(), "configuring hotswap.cpf" );
+        check( dc.startComponents(), "starting hotswap.cpf" );
+        check( dc.connectServices("Monitor", "Sink"), "connecting the services of Monitor and Sink" );
+
+        Sink* old = dynamic_cast<Sink*>( dc.getPeer("Sink") );
+        check( old && receives( old ), "Sink receives the samples of Source" );
+        check( monitor.version.ready() && monitor.version() == 1, "Monitor uses the first Sink" );
+
+        // aborted hot-swaps leave the old instance in place.
+        check( !dc.hotSwapComponent("Sink", "HotSwapUnconfigurableSink"), "hot-swap to a Sink which can't be configured must fail" );
+        check( dc.getPeer("Sink") == old && old->isRunning(), "the old Sink is kept when configure() fails" );
+        check( !dc.hotSwapComponent("Sink", "HotSwapUnstartableSink"), "hot-swap to a Sink which can't be started must fail" );
+        check( dc.getPeer("Sink") == old && old->isRunning(), "the old Sink is kept and runs again when start() fails" );
+        check( receives( old ), "the old Sink is still connected after the aborted hot-swaps" );
+        check( monitor.version() == 1, "Monitor still uses the old Sink" );
+
+        check( dc.hotSwapComponent("Sink", "HotSwapSinkV2"), "hot-swapping the running Sink" );
+        Sink* fresh = dynamic_cast<Sink*>( dc.getPeer("Sink") );
+        check( fresh && fresh != old && fresh->version() == 2, "the new Sink is the peer of the deployer" );
+        check( fresh && fresh->isRunning(), "the new Sink runs" );
+        check( fresh && receives( fresh ), "the new Sink receives the samples of Source" );
+        check( monitor.version.ready() && monitor.version() == 2, "Monitor uses the new Sink" );
+
+        check( dc.stopComponents(), "stopping hotswap.cpf" );
+        check( dc.cleanupComponents(), "cleaning up hotswap.cpf" );
+        check( dc.unloadComponents(), "unloading hotswap.cpf" );
+    }
+
+    if ( failures )
+        std::cerr << failures << " checks failed." << std::endl;
+    else
+        std::cout << "All hot-swap checks passed." << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,87 @@
+#include "deployment/DeploymentComponent.hpp"
+#include <rtt/os/main.h>
+#include <rtt/RTT.hpp>
+#include <iostream>
+
+using namespace Orocos;
+
+class Producer
+    : public RTT::TaskContext
+{
+    RTT::OutputPort<double> out;
+public:
+    Producer(std::string n)
+        : RTT::TaskContext(n), out("out")
+    {
+        this->ports()->addPort( out );
+    }
+};
+
+class Consumer
+    : public RTT::TaskContext
+{
+    RTT::InputPort<double> in;
+public:
+    Consumer(std::string n)
+        : RTT::TaskContext(n), in("in")
+    {
+        this->ports()->addPort( in );
+    }
+};
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if ( !ok ) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static unsigned affinity(RTT::TaskContext& tc)
+{
+    return tc.getActivity()->thread()->getCpuAffinity();
+}
+
+/**
+ * Places the activities of placement.cpf: communicating components
+ * must end up in the same cache domain, and an explicit CPU affinity
+ * must be kept. Without the permission to use real-time threads, RTT
+ * lowers the scheduler and nothing is placed.
+ */
+int ORO_main(int, char**)
+{
+    RTT::Logger::Instance()->setLogLevel(RTT::Logger::Info);
+
+    Producer producer("Producer");
+    Consumer consumer("Consumer");
+    RTT::TaskContext pinned("Pinned");
+
+    DeploymentComponent dc;
+    dc.addPeer( &producer );
+    dc.addPeer( &consumer );
+    dc.addPeer( &pinned );
+
+    check( dc.loadComponents("placement.cpf"), "loading placement.cpf" );
+    check( dc.configureComponents(), "configuring placement.cpf" );
+
+    unsigned pinned_before = affinity( pinned );
+#if defined(ORO_SUPPORT_CPU_AFFINITY) && defined(__linux__)
+    check( dc.placeActivities(), "placeActivities() must be supported on Linux" );
+    if ( producer.getActivity()->thread()->getScheduler() == ORO_SCHED_RT ) {
+        check( affinity( producer ) == affinity( consumer ), "Producer and Consumer share their CPUs" );
+        check( affinity( pinned ) == pinned_before, "keeping the explicit CPU affinity of Pinned" );
+    } else
+        std::cout << "No real-time threads, only the topology was read." << std::endl;
+#else
+    check( !dc.placeActivities(), "placeActivities() is not supported on this platform" );
+    check( affinity( pinned ) == pinned_before, "nothing is placed" );
+#endif
+
+    if ( failures )
+        std::cerr << failures << " checks failed." << std::endl;
+    else
+        std::cout << "All placement checks passed." << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#include "deployment/DeploymentComponent.hpp"
+#include <rtt/os/main.h>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/RTT.hpp>
+#include <iostream>
+#include <vector>
+
+using namespace Orocos;
+
+static RTT::os::Mutex order_lock;
+static std::vector<std::string> order;
+
+static void sleepFor(double seconds)
+{
+    TIME_SPEC ts;
+    ts.tv_sec = (long) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+    rtos_nanosleep(&ts, 0);
+}
+
+/**
+ * Records the order in which the components are started and stopped.
+ */
+class OrderedTask
+    : public RTT::TaskContext
+{
+    double delay;
+    bool starts;
+public:
+    OrderedTask(std::string n, double d = 0.0, bool s = true)
+        : RTT::TaskContext(n), delay(d), starts(s)
+    {}
+    bool startHook() {
+        sleepFor( delay );
+        if ( !starts )
+            return false;
+        RTT::os::MutexLock lock(order_lock);
+        order.push_back( "+" + getName() );
+        return true;
+    }
+    void stopHook() {
+        RTT::os::MutexLock lock(order_lock);
+        order.push_back( "-" + getName() );
+    }
+};
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if ( !ok ) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static size_t position(const std::string& event)
+{
+    RTT::os::MutexLock lock(order_lock);
+    for (size_t i = 0; i != order.size(); ++i)
+        if ( order[i] == event )
+            return i;
+    return order.size();
+}
+
+/**
+ * Starts and stops components in parallel with DependsOn relations,
+ * a circular relation, a start() which exceeds its StartStopTimeout and
+ * a start() which fails. Components depending on the latter two must
+ * not be started.
+ */
+int ORO_main(int, char**)
+{
+    RTT::Logger::Instance()->setLogLevel(RTT::Logger::Info);
+
+    OrderedTask first("First"), second("Second"), third("Third");
+    OrderedTask slow("Slow", 0.5), afterslow("AfterSlow");
+    OrderedTask broken("Broken", 0.0, false), afterbroken("AfterBroken");
+    OrderedTask ping("Ping"), pong("Pong");
+
+    {
+        DeploymentComponent dc;
+        dc.properties()->getPropertyType<bool>("ParallelStartStop")->set( true );
+        dc.addPeer( &first );
+        dc.addPeer( &second );
+        dc.addPeer( &third );
+        dc.addPeer( &slow );
+        dc.addPeer( &afterslow );
+        dc.addPeer( &broken );
+        dc.addPeer( &afterbroken );
+
+        check( dc.loadComponents("startstop.cpf"), "loading startstop.cpf" );
+        check( dc.configureComponents(), "configuring startstop.cpf" );
+        check( !dc.startComponents(), "startComponents() must report the timeout of Slow and the failure of Broken" );
+        check( first.isRunning() && second.isRunning() && third.isRunning(), "starting First, Second and Third" );
+        check( position("+First") < position("+Second") && position("+Second") < position("+Third"),
+               "starting in DependsOn order" );
+        check( !broken.isRunning() && !afterbroken.isRunning(), "not starting what depends on a failed start()" );
+        check( !afterslow.isRunning(), "not starting what depends on a timed out start()" );
+
+        // the start() of Slow is still running.
+        check( !dc.cleanupComponent( &slow ), "cleanup of a component which is still starting must be refused" );
+        sleepFor( 1.0 );
+        check( slow.isRunning(), "Slow started after its timeout" );
+
+        check( dc.stopComponents(), "stopping startstop.cpf" );
+        check( position("-Third") < position("-Second") && position("-Second") < position("-First"),
+               "stopping in reverse DependsOn order" );
+        check( dc.cleanupComponent( &slow ), "cleanup of Slow once its start() returned" );
+    }
+
+    {
+        DeploymentComponent dc;
+        dc.properties()->getPropertyType<bool>("ParallelStartStop")->set( true );
+        dc.addPeer( &ping );
+        dc.addPeer( &pong );
+
+        check( dc.loadComponents("cycle.cpf"), "loading cycle.cpf" );
+        check( dc.configureComponents(), "configuring cycle.cpf" );
+        check( !dc.startComponents(), "startComponents() must detect the circular DependsOn" );
+        check( !ping.isRunning() && !pong.isRunning(), "not starting circular dependencies" );
+    }
+
+    if ( failures )
+        std::cerr << failures << " checks failed." << std::endl;
+    else
+        std::cout << "All start/stop checks passed." << std::endl;
+    return failures ? 1 : 0;
+}
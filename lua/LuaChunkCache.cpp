@@ -0,0 +1,255 @@
+#include "LuaChunkCache.hpp"
+
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/Logger.hpp>
+
+#include <map>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+}
+
+using namespace RTT;
+
+namespace OCL
+{
+  namespace
+  {
+    struct ChunkEntry
+    {
+      uint64_t source_hash;
+      std::string bytecode;
+    };
+
+    std::map<std::string, ChunkEntry> chunks;
+    os::Mutex chunks_lock;
+    std::string cache_dir;
+    bool cache_dir_set = false;
+    bool cache_dir_checked = false;
+
+    /* FNV-1a, good enough to name the cache files */
+    uint64_t hash(const std::string &s, uint64_t h = 14695981039346656037ULL)
+    {
+      for (std::string::size_type i = 0; i < s.size(); ++i) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+      }
+      return h;
+    }
+
+    bool read_file(const std::string &path, std::string &content)
+    {
+      std::ifstream f(path.c_str(), std::ios::in | std::ios::binary);
+      if (!f)
+        return false;
+      std::ostringstream os;
+      os << f.rdbuf();
+      content = os.str();
+      return true;
+    }
+
+    /* Lua 5.1 does not verify bytecode, loading a forged file can
+     * crash or take over the process. Only files owned by us, which
+     * nobody else can write, are trusted. */
+    bool trusted(const struct stat &st)
+    {
+      return st.st_uid == geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+    }
+
+    bool read_bytecode(const std::string &path, std::string &content)
+    {
+      struct stat st;
+      if (lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || !trusted(st))
+        return false;
+      return read_file(path, content);
+    }
+
+    /* atomically replace path, so that other processes never read a
+     * partial file. The file is created private to the user. */
+    void write_bytecode(const std::string &path, const std::string &content)
+    {
+      std::string tmp = path + ".XXXXXX";
+      std::vector<char> name(tmp.begin(), tmp.end());
+      name.push_back('\0');
+      int fd = mkstemp(&name[0]);
+      if (fd < 0)
+        return;
+      bool ok = fchmod(fd, S_IRUSR | S_IWUSR) == 0
+        && write(fd, content.data(), content.size()) == (ssize_t) content.size();
+      ok = close(fd) == 0 && ok;
+      if (!ok || std::rename(&name[0], path.c_str()) != 0)
+        std::remove(&name[0]);
+    }
+
+    int writer(lua_State *, const void *p, size_t sz, void *ud)
+    {
+      static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+      return 0;
+    }
+
+    /* must be called with chunks_lock held. A directory which others
+     * can write to is not used. */
+    const std::string &get_dir()
+    {
+      if (!cache_dir_set) {
+        const char *env = getenv("OCL_LUA_BYTECODE_CACHE");
+        if (env)
+          cache_dir = env;
+        cache_dir_set = true;
+      }
+      if (!cache_dir_checked && !cache_dir.empty()) {
+        struct stat st;
+        if (stat(cache_dir.c_str(), &st) != 0 && errno == ENOENT)
+          mkdir(cache_dir.c_str(), S_IRWXU);
+        if (stat(cache_dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid()
+            || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+          Logger::log(Logger::Warning) << "Lua bytecode cache '" << cache_dir
+                                       << "' must be a directory only accessible by its owner, not caching bytecode." << endlog();
+          cache_dir.clear();
+        }
+      }
+      cache_dir_checked = true;
+      return cache_dir;
+    }
+  }
+
+  void chunkcache_set_dir(const std::string &dir)
+  {
+    os::MutexLock lock(chunks_lock);
+    cache_dir = dir;
+    cache_dir_set = true;
+    cache_dir_checked = false;
+  }
+
+  int chunkcache_loadfile(lua_State *L, const char *path)
+  {
+    struct stat st;
+    std::string chunkname = std::string("@") + path;
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+      return luaL_loadfile(L, path); // let Lua report the error
+
+    // the modification time is too coarse to notice every edit, the
+    // content decides whether the cached bytecode is still valid.
+    std::string source;
+    if (!read_file(path, source))
+      return luaL_loadfile(L, path);
+
+    // like luaL_loadfile, skip a '#!' line but keep the line numbers
+    if (!source.empty() && source[0] == '#') {
+      std::string::size_type nl = source.find('\n');
+      source.erase(0, nl == std::string::npos ? source.size() : nl);
+    }
+
+    ChunkEntry entry;
+    entry.source_hash = hash(source);
+
+    std::string dir;
+    {
+      os::MutexLock lock(chunks_lock);
+      std::map<std::string, ChunkEntry>::iterator it = chunks.find(path);
+      if (it != chunks.end() && it->second.source_hash == entry.source_hash)
+        return luaL_loadbuffer(L, it->second.bytecode.data(), it->second.bytecode.size(), chunkname.c_str());
+      dir = get_dir();
+    }
+
+    std::string diskfile;
+    if (!dir.empty()) {
+      std::ostringstream os;
+      os << dir << "/" << std::hex << hash(source, hash(path)) << ".luac";
+      diskfile = os.str();
+      // bytecode of another Lua version or architecture fails to load
+      if (read_bytecode(diskfile, entry.bytecode)) {
+        if (luaL_loadbuffer(L, entry.bytecode.data(), entry.bytecode.size(), chunkname.c_str()) == 0)
+          goto store;
+        lua_pop(L, 1);
+        entry.bytecode.clear();
+      }
+    }
+
+    {
+      int ret = luaL_loadbuffer(L, source.data(), source.size(), chunkname.c_str());
+      if (ret != 0)
+        return ret;
+    }
+    lua_dump(L, writer, &entry.bytecode);
+    if (!diskfile.empty())
+      write_bytecode(diskfile, entry.bytecode);
+
+  store:
+    {
+      os::MutexLock lock(chunks_lock);
+      chunks[path] = entry;
+    }
+    return 0;
+  }
+
+  int chunkcache_dofile(lua_State *L, const char *path)
+  {
+    return chunkcache_loadfile(L, path) || lua_pcall(L, 0, LUA_MULTRET, 0);
+  }
+
+  /* package.loaders[2] replacement, see loader_Lua in loadlib.c */
+  static int chunkcache_searcher(lua_State *L)
+  {
+    const char *name = luaL_checkstring(L, 1);
+    const char *path;
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "path");
+    path = lua_tostring(L, -1);
+    if (path == NULL)
+      luaL_error(L, "'package.path' must be a string");
+
+    name = luaL_gsub(L, name, ".", LUA_DIRSEP);
+    lua_pushliteral(L, "");  /* error accumulator */
+
+    while (*path) {
+      const char *end = path;
+      while (*end && *end != *LUA_PATHSEP)
+        ++end;
+      if (end != path) {
+        lua_pushlstring(L, path, end - path);
+        const char *filename = luaL_gsub(L, lua_tostring(L, -1), LUA_PATH_MARK, name);
+        lua_remove(L, -2);
+        FILE *f = fopen(filename, "r");
+        if (f) {
+          fclose(f);
+          if (chunkcache_loadfile(L, filename) != 0)
+            luaL_error(L, "error loading module '%s' from file '%s':\n\t%s",
+                       lua_tostring(L, 1), filename, lua_tostring(L, -1));
+          return 1;
+        }
+        lua_pushfstring(L, "\n\tno file '%s'", filename);
+        lua_remove(L, -2);
+        lua_concat(L, 2);
+      }
+      path = *end ? end + 1 : end;
+    }
+    return 1;  /* the accumulated error message */
+  }
+
+  void chunkcache_install_loader(lua_State *L)
+  {
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "loaders");
+    if (lua_istable(L, -1)) {
+      lua_pushcfunction(L, chunkcache_searcher);
+      lua_rawseti(L, -2, 2);
+    }
+    lua_pop(L, 2);
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef OCL_LUACHUNKCACHE_HPP
+#define OCL_LUACHUNKCACHE_HPP
+
+#include <string>
+
+struct lua_State;
+
+namespace OCL
+{
+  /**
+   * Process wide cache of compiled Lua chunks.
+   *
+   * Scripts are compiled once per process and stored as bytecode,
+   * keyed by their path. A cached chunk is used as long as a hash of
+   * the content of the file did not change. Every lua_State still
+   * gets its own copy of the function, but loading the bytecode
+   * skips the parser. The cache lives in orocos-ocl-lua-common, so
+   * all Lua components, services and plugins of a process share it.
+   *
+   * If a cache directory is set, with chunkcache_set_dir() or the
+   * OCL_LUA_BYTECODE_CACHE environment variable, the bytecode is also
+   * written to and read from that directory, keyed by a hash of the
+   * path and the content of the script, so that later processes
+   * don't need to parse it either. Lua does not verify bytecode, so
+   * the directory must be owned by the user and not accessible by
+   * anybody else, and only files the user owns and nobody else can
+   * write are loaded from it. It is created if it does not exist.
+   */
+
+  /**
+   * Like luaL_loadfile(): pushes the compiled chunk or an error
+   * message and returns 0 on success.
+   */
+  int chunkcache_loadfile(lua_State *L, const char *path);
+
+  /**
+   * Like luaL_dofile(), but loads through the cache.
+   */
+  int chunkcache_dofile(lua_State *L, const char *path);
+
+  /**
+   * Replaces the Lua file searcher of require() by one that loads
+   * modules through the cache.
+   */
+  void chunkcache_install_loader(lua_State *L);
+
+  /**
+   * Sets the directory to persist bytecode in, or disables
+   * persisting if dir is empty.
+   */
+  void chunkcache_set_dir(const std::string &dir);
+}
+
+#endif // OCL_LUACHUNKCACHE_HPP
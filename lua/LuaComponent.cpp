@@ -34,12 +34,18 @@
 
 #include "LuaComponent.hpp"
 #include <iostream>
+#include <cstdlib>
 
 #include "rtt.hpp"
+#include "LuaChunkCache.hpp"
 
 #ifdef LUA_RTT_TLSF
+#include <rtt/Activity.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+
 extern "C" {
 #include "tlsf_rtt.h"
+#include "tlsf.h"
 }
 #endif
 
@@ -53,10 +59,41 @@ using namespace RTT;
 
 namespace OCL
 {
+  static const char *hook_names[] = { "configureHook", "activateHook", "startHook", "updateHook",
+                                      "stopHook", "cleanupHook", "errorHook" };
+
+#ifdef LUA_RTT_TLSF
+  /**
+   * Periodically checks the pool usage from a non real-time thread and
+   * adds memory before the pool runs out.
+   */
+  class LuaComponent::TLSFGrower : public base::RunnableInterface
+  {
+    LuaComponent *comp;
+  public:
+    TLSFGrower(LuaComponent *c) : comp(c) {}
+    bool initialize() { return true; }
+    void step() { comp->tlsf_grow(); }
+    void finalize() {}
+  };
+#endif
+
   LuaComponent::LuaComponent(std::string name)
-    : TaskContext(name, PreOperational)
+    : TaskContext(name, PreOperational), state_lock(m), hooks_seen(-1),
+      gc_incremental(false), gc_step_size(1), gc_margin(0.0002), gc_max_time(0.0), gc_emergency(0.9),
+      gc_steps(0), gc_cycles(0), gc_full(0), gc_collected(0.0), gc_step_time_last(0.0), gc_step_time_max(0.0)
+#ifdef LUA_RTT_TLSF
+      , tlsf_used(0), tlsf_free(0), tlsf_max_used(0), tlsf_largest_free(0), tlsf_total(0), tlsf_alloc_failures(0),
+      tlsf_used_port("tlsf_used"), tlsf_free_port("tlsf_free"), tlsf_max_used_port("tlsf_max_used"),
+      tlsf_largest_free_port("tlsf_largest_free"), tlsf_alloc_failures_port("tlsf_alloc_failures"),
+      tlsf_grow_threshold(0.8), tlsf_grow_size(TLSF_INITIAL_POOLSIZE), tlsf_grower(0), tlsf_grower_act(0),
+      tlsf_pub_used(0), tlsf_pub_total(0), tlsf_pub_full(0),
+      tlsf_area_state(AreaFree), tlsf_new_area(0), tlsf_new_area_size(0), tlsf_area_handed(false)
+#endif
   {
     os::MutexLock lock(m);
+    for (int i = 0; i < HookCount; ++i)
+      hook_refs[i] = LUA_NOREF;
 #if LUA_RTT_TLSF
     tlsf_inf = new lua_tlsf_info;
     if(tlsf_rtt_init_mp(tlsf_inf, TLSF_INITIAL_POOLSIZE)) {
@@ -81,6 +118,7 @@ namespace OCL
     lua_gc(L, LUA_GCSTOP, 0);
     luaL_openlibs(L);
     lua_gc(L, LUA_GCRESTART, 0);
+    chunkcache_install_loader(L);
 
     /* setup rtt bindings */
     lua_pushcfunction(L, luaopen_rtt);
@@ -91,6 +129,20 @@ namespace OCL
     this->addProperty("lua_string", lua_string).doc("string of lua code to be executed during configureHook");
     this->addProperty("lua_file", lua_file).doc("file with lua program to be executed during configuration");
 
+    this->addProperty("gc_incremental", gc_incremental).doc("stop the automatic garbage collector and collect incrementally in the idle time after updateHook. Applied in startHook");
+    this->addProperty("gc_step_size", gc_step_size).doc("size of one incremental collection step (LUA_GCSTEP argument, in kB)");
+    this->addProperty("gc_margin", gc_margin).doc("time in seconds to keep free before the end of the period");
+    this->addProperty("gc_max_time", gc_max_time).doc("maximum time in seconds spent collecting per cycle, 0 for the whole idle time");
+#ifdef LUA_RTT_TLSF
+    this->addProperty("gc_emergency", gc_emergency).doc("fraction of the TLSF pool in use above which a full collection is done");
+#endif
+    this->addProperty("gc_steps", gc_steps).doc("number of incremental collection steps done");
+    this->addProperty("gc_cycles", gc_cycles).doc("number of completed incremental collection cycles");
+    this->addProperty("gc_full", gc_full).doc("number of emergency full collections");
+    this->addProperty("gc_collected", gc_collected).doc("number of bytes freed by the incremental collection");
+    this->addProperty("gc_step_time_last", gc_step_time_last).doc("time in seconds spent collecting in the last cycle");
+    this->addProperty("gc_step_time_max", gc_step_time_max).doc("longest time in seconds spent collecting in a cycle");
+
     this->addOperation("exec_file", &LuaComponent::exec_file, this, OwnThread)
       .doc("load (and run) the given lua script")
       .arg("filename", "filename of the lua script");
@@ -103,11 +155,38 @@ namespace OCL
     this->addOperation("tlsf_incmem", &LuaComponent::tlsf_incmem, this, OwnThread)
       .doc("increase the TLSF memory pool")
       .arg("size", "size in bytes to add to pool");
+
+    this->addAttribute("tlsf_used", tlsf_used);
+    this->addAttribute("tlsf_free", tlsf_free);
+    this->addAttribute("tlsf_max_used", tlsf_max_used);
+    this->addAttribute("tlsf_largest_free", tlsf_largest_free);
+    this->addAttribute("tlsf_total", tlsf_total);
+    this->addAttribute("tlsf_alloc_failures", tlsf_alloc_failures);
+    this->ports()->addPort(tlsf_used_port).doc("bytes in use in the TLSF pool");
+    this->ports()->addPort(tlsf_free_port).doc("bytes free in the TLSF pool");
+    this->ports()->addPort(tlsf_max_used_port).doc("largest number of bytes ever in use in the TLSF pool");
+    this->ports()->addPort(tlsf_largest_free_port).doc("size of the largest free block of the TLSF pool");
+    this->ports()->addPort(tlsf_alloc_failures_port).doc("number of failed allocations from the TLSF pool");
+
+    this->addProperty("tlsf_grow_threshold", tlsf_grow_threshold).doc("fraction of the TLSF pool in use above which memory is added in the background, 0 to disable. Applied in startHook");
+    this->addProperty("tlsf_grow_size", tlsf_grow_size).doc("number of bytes added to the TLSF pool when it grows");
+
+    tlsf_update_stats();
 #endif
   }
 
   LuaComponent::~LuaComponent()
   {
+#ifdef LUA_RTT_TLSF
+    if (tlsf_grower_act) {
+      tlsf_grower_act->stop();
+      delete tlsf_grower_act;
+      delete tlsf_grower;
+    }
+    // an area which was not linked in yet is still ours
+    if (tlsf_area_state.read() != AreaFree)
+      free(tlsf_new_area);
+#endif
     os::MutexLock lock(m);
     lua_close(L);
 #ifdef LUA_RTT_TLSF
@@ -119,29 +198,144 @@ namespace OCL
 #ifdef LUA_RTT_TLSF
   bool LuaComponent::tlsf_incmem(unsigned int size)
   {
-    return tlsf_rtt_incmem(tlsf_inf, size);
+    bool locked = state_lock.enter();
+    bool ret = tlsf_rtt_incmem(tlsf_inf, size) == 0;
+    state_lock.leave(locked);
+    return ret;
+  }
+
+  /* called in the component's thread. Links in an area handed over
+   * by the grower and publishes the pool usage for it, such that the
+   * grower never needs the state. The ports are only written when a
+   * value changed, an idle pool costs no port writes. */
+  void LuaComponent::tlsf_update_stats()
+  {
+    struct tlsf_rtt_stats st;
+    int area = tlsf_area_state.read();
+    bool locked = state_lock.enter();
+    if (area == AreaReady)
+      area = tlsf_rtt_add_area(tlsf_inf, tlsf_new_area, tlsf_new_area_size) == 0 ? AreaFree : AreaRejected;
+    tlsf_rtt_get_stats(tlsf_inf, &st);
+    bool full = tlsf_inf->n_areas >= TLSF_MAX_AREAS;
+    state_lock.leave(locked);
+
+    tlsf_pub_used.set(st.used);
+    tlsf_pub_total.set(st.total);
+    tlsf_pub_full.set(full);
+    tlsf_area_state.cas(AreaReady, area);
+
+    tlsf_total = st.total;
+    if (tlsf_used != st.used) {
+      tlsf_used = st.used;
+      tlsf_used_port.write(tlsf_used);
+    }
+    if (tlsf_free != st.free) {
+      tlsf_free = st.free;
+      tlsf_free_port.write(tlsf_free);
+    }
+    if (tlsf_max_used != st.max_used) {
+      tlsf_max_used = st.max_used;
+      tlsf_max_used_port.write(tlsf_max_used);
+    }
+    if (tlsf_largest_free != st.largest_free) {
+      tlsf_largest_free = st.largest_free;
+      tlsf_largest_free_port.write(tlsf_largest_free);
+    }
+    if (tlsf_alloc_failures != st.alloc_failures) {
+      tlsf_alloc_failures = st.alloc_failures;
+      tlsf_alloc_failures_port.write(tlsf_alloc_failures);
+    }
+  }
+
+  /* called in the grower's thread. It only reads the usage published
+   * by the component's thread and hands a new area over to it, the
+   * state itself is never locked: rttlua holds it for the whole
+   * interactive session and the component's thread must not wait for
+   * the grower. An area is only handed over when the previous one was
+   * linked in or rejected. */
+  void LuaComponent::tlsf_grow()
+  {
+    int state = tlsf_area_state.read();
+    if (state == AreaRejected) {
+      free(tlsf_new_area);
+      tlsf_area_handed = false;
+      tlsf_area_state.cas(AreaRejected, AreaFree);
+      return;
+    }
+    if (state != AreaFree)
+      return;
+    if (tlsf_area_handed) {
+      tlsf_area_handed = false;
+      Logger::log(Logger::Info) << "LuaComponent '" << this->getName() << "': grew TLSF pool by " << tlsf_new_area_size
+                << " to " << (unsigned int) tlsf_pub_total.read() << " bytes" << endlog();
+    }
+
+    if (tlsf_grow_threshold <= 0.0 || tlsf_grow_size == 0 || tlsf_pub_full.read())
+      return;
+    unsigned int used = tlsf_pub_used.read(), total = tlsf_pub_total.read();
+    if (used < tlsf_grow_threshold * total)
+      return;
+
+    size_t size = tlsf_grow_size;
+    void *area = tlsf_rtt_area_alloc(size);
+    if (!area) {
+      Logger::log(Logger::Error) << "LuaComponent '" << this->getName() << "': failed to allocate " << size
+                 << " bytes to grow the TLSF pool" << endlog();
+      return;
+    }
+    tlsf_new_area = area;
+    tlsf_new_area_size = size;
+    tlsf_area_handed = true;
+    tlsf_area_state.cas(AreaFree, AreaReady);
   }
 #endif
 
 
   bool LuaComponent::exec_file(const std::string &file)
   {
-    os::MutexLock lock(m);
-    if (luaL_dofile(L, file.c_str())) {
+    bool ret = true;
+    bool locked = state_lock.enter();
+    if (chunkcache_dofile(L, file.c_str())) {
       Logger::log(Logger::Error) << "LuaComponent '" << this->getName() << "': " << lua_tostring(L, -1) << endlog();
-      return false;
+      lua_pop(L, 1);
+      ret = false;
     }
-    return true;
+    resolve_hooks();
+    state_lock.leave(locked);
+    return ret;
   }
 
   bool LuaComponent::exec_str(const std::string &str)
   {
-    os::MutexLock lock(m);
+    bool ret = true;
+    bool locked = state_lock.enter();
     if (luaL_dostring(L, str.c_str())) {
       Logger::log(Logger::Error) << "LuaComponent '" << this->getName() << "': " << lua_tostring(L, -1) << endlog();
-      return false;
+      lua_pop(L, 1);
+      ret = false;
     }
-    return true;
+    resolve_hooks();
+    state_lock.leave(locked);
+    return ret;
+  }
+
+  /* must be called with the state entered */
+  void LuaComponent::resolve_hooks()
+  {
+    for (int i = 0; i < HookCount; ++i)
+      hook_refs[i] = func_ref(L, hook_names[i], hook_refs[i]);
+    hooks_seen = state_lock.releases();
+  }
+
+  bool LuaComponent::call_hook(int hook, int require_result)
+  {
+    bool locked = state_lock.enter();
+    // the state was used by another thread, which may have (re)defined hooks
+    if (hooks_seen != state_lock.releases())
+      resolve_hooks();
+    bool ret = call_func_ref(L, hook_refs[hook], hook_names[hook], this, 0, require_result);
+    state_lock.leave(locked);
+    return ret;
   }
 
   bool LuaComponent::configureHook()
@@ -151,48 +345,121 @@ namespace OCL
 
     if(!lua_file.empty())
       exec_file(lua_file);
-    return call_func(L, "configureHook", this, 0, 1);
+    return call_hook(ConfigureHook, 1);
   }
 
   bool LuaComponent::activateHook()
   {
-    os::MutexLock lock(m);
-    return call_func(L, "activateHook", this, 0, 1);
+    return call_hook(ActivateHook, 1);
   }
 
   bool LuaComponent::startHook()
   {
-    os::MutexLock lock(m);
-    return call_func(L, "startHook", this, 0, 1);
+    gc_apply();
+#ifdef LUA_RTT_TLSF
+    if (tlsf_grow_threshold > 0.0 && tlsf_grow_size != 0) {
+      if (!tlsf_grower) {
+        tlsf_grower = new TLSFGrower(this);
+        tlsf_grower_act = new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.1, tlsf_grower, this->getName() + ".tlsf");
+      }
+      tlsf_grower_act->start();
+    }
+#endif
+    return call_hook(StartHook, 1);
   }
 
   void LuaComponent::updateHook()
   {
-    os::MutexLock lock(m);
-    call_func(L, "updateHook", this, 0, 0);
+    os::TimeService::nsecs start = os::TimeService::Instance()->getNSecs();
+    call_hook(UpdateHook, 0);
+    if (gc_incremental)
+      gc_idle(start);
+#ifdef LUA_RTT_TLSF
+    tlsf_update_stats();
+#endif
   }
 
   void LuaComponent::stopHook()
   {
-    os::MutexLock lock(m);
-    call_func(L, "stopHook", this, 0, 0);
+#ifdef LUA_RTT_TLSF
+    if (tlsf_grower_act)
+      tlsf_grower_act->stop();
+#endif
+    call_hook(StopHook, 0);
+    bool locked = state_lock.enter();
+    lua_gc(L, LUA_GCRESTART, 0);
+    state_lock.leave(locked);
+  }
+
+  void LuaComponent::gc_apply()
+  {
+    bool locked = state_lock.enter();
+    lua_gc(L, gc_incremental ? LUA_GCSTOP : LUA_GCRESTART, 0);
+    state_lock.leave(locked);
+  }
+
+  /* Run incremental collection steps until the collection cycle is
+   * complete or the time left in this period is used up. */
+  void LuaComponent::gc_idle(os::TimeService::nsecs cycle_start)
+  {
+    os::TimeService *ts = os::TimeService::Instance();
+    double period = this->getActivity() ? this->getActivity()->getPeriod() : 0.0;
+    os::TimeService::nsecs now = ts->getNSecs();
+    os::TimeService::nsecs deadline;
+    int before, after;
+
+    if (period > 0.0)
+      deadline = cycle_start + (os::TimeService::nsecs)((period - gc_margin) * 1e9);
+    else
+      deadline = now; // not periodic: one step per trigger
+    if (gc_max_time > 0.0 && now + (os::TimeService::nsecs)(gc_max_time * 1e9) < deadline)
+      deadline = now + (os::TimeService::nsecs)(gc_max_time * 1e9);
+
+    bool locked = state_lock.enter();
+    os::TimeService::nsecs gc_start = now;
+    do {
+      before = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+      int done = lua_gc(L, LUA_GCSTEP, gc_step_size);
+      after = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+      ++gc_steps;
+      if (after < before)
+        gc_collected += before - after;
+      now = ts->getNSecs();
+      if (done) {
+        ++gc_cycles;
+        break;
+      }
+    } while (now < deadline);
+
+#ifdef LUA_RTT_TLSF
+    if (rtl_get_used_size(tlsf_inf->pool) > gc_emergency * tlsf_inf->total_mem) {
+      lua_gc(L, LUA_GCCOLLECT, 0);
+      ++gc_full;
+      now = ts->getNSecs();
+    }
+#endif
+    // a step sets a new threshold, which restarts the automatic collector
+    lua_gc(L, LUA_GCSTOP, 0);
+    state_lock.leave(locked);
+
+    gc_step_time_last = (now - gc_start) * 1e-9;
+    if (gc_step_time_last > gc_step_time_max)
+      gc_step_time_max = gc_step_time_last;
   }
 
   void LuaComponent::cleanupHook()
   {
-    os::MutexLock lock(m);
-    call_func(L, "cleanupHook", this, 0, 0);
+    call_hook(CleanupHook, 0);
   }
 
   void LuaComponent::errorHook()
   {
-    os::MutexLock lock(m);
-    call_func(L, "errorHook", this, 0, 0);
+    call_hook(ErrorHook, 0);
   }
 
   LuaStateHandle LuaComponent::getLuaState()
   {
-    return LuaStateHandle(L, m);
+    return LuaStateHandle(L, state_lock);
   }
 
 } // namespace OCL
@@ -37,7 +37,9 @@
 
 #include <string>
 #include <rtt/os/Mutex.hpp>
+#include <rtt/os/TimeService.hpp>
 #include <rtt/TaskContext.hpp>
+#include <rtt/OutputPort.hpp>
 
 #include "LuaStateHandle.hpp"
 
@@ -55,6 +57,31 @@ namespace OCL
     std::string lua_file;
     lua_State *L;
     RTT::os::MutexRecursive m;
+    LuaStateLock state_lock;
+
+    /* registry references to the Lua hook functions */
+    enum { ConfigureHook, ActivateHook, StartHook, UpdateHook, StopHook, CleanupHook, ErrorHook, HookCount };
+    int hook_refs[HookCount];
+    int hooks_seen;
+
+    void resolve_hooks();
+    bool call_hook(int hook, int require_result);
+
+    /* garbage collection policy and statistics */
+    bool gc_incremental;
+    int gc_step_size;
+    double gc_margin;
+    double gc_max_time;
+    double gc_emergency;
+    unsigned int gc_steps;
+    unsigned int gc_cycles;
+    unsigned int gc_full;
+    double gc_collected;
+    double gc_step_time_last;
+    double gc_step_time_max;
+
+    void gc_apply();
+    void gc_idle(RTT::os::TimeService::nsecs cycle_start);
 
   public:
     LuaComponent(std::string name);
@@ -82,8 +109,71 @@ namespace OCL
     std::string lua_file;
     lua_State *L;
     RTT::os::MutexRecursive m;
+    LuaStateLock state_lock;
+
+    /* registry references to the Lua hook functions */
+    enum { ConfigureHook, ActivateHook, StartHook, UpdateHook, StopHook, CleanupHook, ErrorHook, HookCount };
+    int hook_refs[HookCount];
+    int hooks_seen;
+
+    void resolve_hooks();
+    bool call_hook(int hook, int require_result);
+
+    /* garbage collection policy and statistics */
+    bool gc_incremental;
+    int gc_step_size;
+    double gc_margin;
+    double gc_max_time;
+    double gc_emergency;
+    unsigned int gc_steps;
+    unsigned int gc_cycles;
+    unsigned int gc_full;
+    double gc_collected;
+    double gc_step_time_last;
+    double gc_step_time_max;
+
+    void gc_apply();
+    void gc_idle(RTT::os::TimeService::nsecs cycle_start);
     struct lua_tlsf_info *tlsf_inf;
 
+    /* pool statistics, in bytes */
+    unsigned int tlsf_used;
+    unsigned int tlsf_free;
+    unsigned int tlsf_max_used;
+    unsigned int tlsf_largest_free;
+    unsigned int tlsf_total;
+    unsigned int tlsf_alloc_failures;
+    RTT::OutputPort<unsigned int> tlsf_used_port;
+    RTT::OutputPort<unsigned int> tlsf_free_port;
+    RTT::OutputPort<unsigned int> tlsf_max_used_port;
+    RTT::OutputPort<unsigned int> tlsf_largest_free_port;
+    RTT::OutputPort<unsigned int> tlsf_alloc_failures_port;
+
+    /* background growth of the pool */
+    double tlsf_grow_threshold;
+    unsigned int tlsf_grow_size;
+    class TLSFGrower;
+    TLSFGrower *tlsf_grower;
+    RTT::base::ActivityInterface *tlsf_grower_act;
+
+    /* pool usage, published by the component's thread for the grower */
+    RTT::os::AtomicInt tlsf_pub_used;
+    RTT::os::AtomicInt tlsf_pub_total;
+    RTT::os::AtomicInt tlsf_pub_full;
+
+    /* an area handed from the grower to the component's thread, which
+     * links it in or rejects it. tlsf_new_area and tlsf_new_area_size
+     * are only touched by the thread whose turn it is: the grower in
+     * AreaFree and AreaRejected, the component's thread in AreaReady. */
+    enum { AreaFree, AreaReady, AreaRejected };
+    RTT::os::AtomicInt tlsf_area_state;
+    void *tlsf_new_area;
+    size_t tlsf_new_area_size;
+    bool tlsf_area_handed;
+
+    void tlsf_update_stats();
+    void tlsf_grow();
+
   public:
     LuaTLSFComponent(std::string name);
     ~LuaTLSFComponent();
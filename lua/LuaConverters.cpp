@@ -0,0 +1,81 @@
+/*
+ * Registry of Lua converters for typekit types, see rtt.hpp.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * As a special exception, you may use this file as part of a free
+ * software library without restriction.  Specifically, if other files
+ * instantiate templates or use macros or inline functions from this
+ * file, or you compile this file and link it with other files to
+ * produce an executable, this file does not by itself cause the
+ * resulting executable to be covered by the GNU General Public
+ * License.  This exception does not however invalidate any other
+ * reasons why the executable file might be covered by the GNU General
+ * Public License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place,
+ * Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "rtt.hpp"
+
+#include <rtt/os/Atomic.hpp>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+
+using namespace RTT;
+
+/* The entries are never modified or freed: a binding may still use a
+ * converter it cached until it notices the new generation. */
+static VariableConvList& converters()
+{
+	static VariableConvList list;
+	return list;
+}
+
+static os::Mutex& converters_lock()
+{
+	static os::Mutex lock;
+	return lock;
+}
+
+static os::AtomicInt conv_generation(1);
+
+void Variable_register_converter(const std::string& type, Variable_tolua_fn tolua, Variable_fromlua_fn fromlua)
+{
+	VariableConv *conv = new VariableConv();
+	conv->tolua = tolua;
+	conv->fromlua = fromlua;
+
+	os::MutexLock lock(converters_lock());
+	VariableConvList& list = converters();
+	VariableConvList::iterator it = list.begin();
+	while(it != list.end() && it->first != type)
+		++it;
+	if(it != list.end())
+		it->second = conv;
+	else
+		list.push_back(std::make_pair(type, (const VariableConv*) conv));
+	conv_generation.inc();
+}
+
+VariableConvList Variable_converters()
+{
+	os::MutexLock lock(converters_lock());
+	return converters();
+}
+
+int Variable_converters_generation()
+{
+	return conv_generation.read();
+}
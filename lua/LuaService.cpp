@@ -7,6 +7,7 @@
 #include <iostream>
 
 #include "rtt.hpp"
+#include "LuaChunkCache.hpp"
 
 #ifdef LUA_RTT_TLSF
 extern "C" {
@@ -61,6 +62,7 @@ namespace OCL {
     lua_gc(L, LUA_GCSTOP, 0);
     luaL_openlibs(L);
     lua_gc(L, LUA_GCRESTART, 0);
+    chunkcache_install_loader(L);
 
     /* setup rtt bindings */
     lua_pushcfunction(L, luaopen_rtt);
@@ -105,7 +107,7 @@ namespace OCL {
   bool LuaService::exec_file(const std::string &file)
   {
     os::MutexLock lock(m);
-    if (luaL_dofile(L, file.c_str())) {
+    if (chunkcache_dofile(L, file.c_str())) {
       Logger::log(Logger::Error) << "LuaService '" << this->getOwner()->getName()
                << "': " << lua_tostring(L, -1) << endlog();
       return false;
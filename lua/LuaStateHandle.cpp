@@ -1,4 +1,5 @@
 #include "LuaStateHandle.hpp"
+#include <rtt/os/fosi.h>
 
 namespace OCL
 {
@@ -44,4 +45,117 @@ namespace OCL
     return L;
   }
 
+
+  namespace
+  {
+#ifdef _MSC_VER
+# define OCL_THREAD_LOCAL __declspec(thread)
+#else
+# define OCL_THREAD_LOCAL __thread
+#endif
+    RTT::os::AtomicInt thread_ids(0);
+
+    /* a number identifying the calling thread, never 0 */
+    int self()
+    {
+      static OCL_THREAD_LOCAL int id = 0;
+      if (id == 0) {
+        int last;
+        do {
+          last = thread_ids.read();
+        } while (!thread_ids.cas(last, last + 1));
+        id = last + 1;
+      }
+      return id;
+    }
+  }
+
+  LuaStateLock::LuaStateLock(RTT::os::MutexRecursive &mutex)
+    : m(mutex), foreign(0), owner(0), released(0), depth(0)
+  {}
+
+  bool LuaStateLock::enter()
+  {
+    int me = self();
+
+    // nested use from the owner, e.g. a hook calling exec_str
+    if (owner.read() == me) {
+      ++depth;
+      return false;
+    }
+
+    // take ownership, then check again that no other thread
+    // announced itself in the meantime
+    if (foreign.read() == 0 && owner.cas(0, me)) {
+      if (foreign.read() == 0) {
+        depth = 1;
+        return false;
+      }
+      owner.set(0);
+    }
+
+    lock();
+    return true;
+  }
+
+  void LuaStateLock::leave(bool locked)
+  {
+    if (locked)
+      unlock();
+    else if (--depth == 0)
+      owner.set(0);
+  }
+
+  void LuaStateLock::waitOutside()
+  {
+    TIME_SPEC ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 100000;
+    int me = self();
+    int o;
+    while ((o = owner.read()) != 0 && o != me)
+      rtos_nanosleep(&ts, NULL);
+  }
+
+  void LuaStateLock::lock()
+  {
+    foreign.inc();
+    m.lock();
+    waitOutside();
+  }
+
+  void LuaStateLock::unlock()
+  {
+    released.inc();
+    m.unlock();
+    foreign.dec();
+  }
+
+  bool LuaStateLock::trylock()
+  {
+    foreign.inc();
+    if (!m.trylock()) {
+      foreign.dec();
+      return false;
+    }
+    int o = owner.read();
+    if (o != 0 && o != self()) {
+      m.unlock();
+      foreign.dec();
+      return false;
+    }
+    return true;
+  }
+
+  bool LuaStateLock::timedlock(RTT::Seconds s)
+  {
+    foreign.inc();
+    if (!m.timedlock(s)) {
+      foreign.dec();
+      return false;
+    }
+    waitOutside();
+    return true;
+  }
+
 } // namespace OCL
@@ -2,6 +2,8 @@
 #define OCL_LUASTATEHANDLE_HPP
 
 #include <rtt/os/MutexLock.hpp>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/Atomic.hpp>
 
 struct lua_State;
 
@@ -27,6 +29,55 @@ namespace OCL
 
   };
 
+  /**
+   * Protects a Lua state which is mostly used by the thread of its
+   * component, without taking a mutex in every hook.
+   *
+   * Every use of the state from the component is bracketed with
+   * enter() and leave(). As long as no other thread wants the state,
+   * the entering thread becomes the owner with one atomic
+   * compare-and-swap, and nested enters by the owner cost nothing.
+   * Any other thread takes the mutex. Threads which use the lock()
+   * and unlock() of the MutexInterface, for example through a
+   * LuaStateHandle, announce themselves, take the mutex and wait
+   * until the owner left the state. While they are announced,
+   * enter() takes the mutex too.
+   */
+  class LuaStateLock : public RTT::os::MutexInterface
+  {
+  private:
+    RTT::os::MutexRecursive &m;
+    RTT::os::AtomicInt foreign;
+    RTT::os::AtomicInt owner;
+    RTT::os::AtomicInt released;
+    /** nesting of the owner, only touched by the owner */
+    int depth;
+
+    void waitOutside();
+
+  public:
+    LuaStateLock(RTT::os::MutexRecursive &mutex);
+
+    /**
+     * Called before using the state from the component.
+     * @return true if the mutex was taken, which must be passed
+     * to leave().
+     */
+    bool enter();
+    void leave(bool locked);
+
+    /**
+     * Number of times another thread released the state. Lets the
+     * component notice that the state may have been changed.
+     */
+    int releases() { return released.read(); }
+
+    void lock();
+    void unlock();
+    bool trylock();
+    bool timedlock(RTT::Seconds s);
+  };
+
 } // namespace OCL
 
 #endif // OCL_LUASTATEHANDLE_HPP
@@ -0,0 +1,351 @@
+/*
+ * Lua-RTT bindings. LuaWorkerPool.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * As a special exception, you may use this file as part of a free
+ * software library without restriction.  Specifically, if other files
+ * instantiate templates or use macros or inline functions from this
+ * file, or you compile this file and link it with other files to
+ * produce an executable, this file does not by itself cause the
+ * resulting executable to be covered by the GNU General Public
+ * License.  This exception does not however invalidate any other
+ * reasons why the executable file might be covered by the GNU General
+ * Public License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place,
+ * Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "LuaWorkerPool.hpp"
+#include <sstream>
+
+#include <rtt/Activity.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/os/MutexLock.hpp>
+
+#include "rtt.hpp"
+#include "LuaChunkCache.hpp"
+
+using namespace RTT;
+
+namespace OCL
+{
+  /* takes jobs from the queue and executes them in its own Lua state */
+  class LuaWorkerPool::Worker : public base::RunnableInterface
+  {
+    LuaWorkerPool *pool;
+    lua_State *L;
+  public:
+    Worker(LuaWorkerPool *p, lua_State *state) : pool(p), L(state) {}
+    bool initialize() { return true; }
+    void step() {}
+    void finalize() {}
+
+    void loop()
+    {
+      Job *job;
+      while (true) {
+        pool->pending.wait();
+        if (pool->stopping.read())
+          break;
+        if (pool->queue->Pop(job))
+          pool->execute(L, job);
+      }
+    }
+
+    bool breakLoop()
+    {
+      // stopHook signals the semaphore once for each worker
+      return true;
+    }
+  };
+
+  LuaWorkerPool::LuaWorkerPool(std::string name)
+    : TaskContext(name, PreOperational),
+      workers(2), queue_size(128), queue(0), pending(0), stopping(0), accepting(false),
+      next_id(0), jobs_done(0), jobs_failed(0),
+      results_port("results"), result_sample(3)
+  {
+    this->addProperty("lua_string", lua_string).doc("string of lua code to be executed in every worker state during configureHook");
+    this->addProperty("lua_file", lua_file).doc("file with lua program to be executed in every worker state during configureHook");
+    this->addProperty("workers", workers).doc("number of Lua states, each with its own thread. Applied in configureHook");
+    this->addProperty("queue_size", queue_size).doc("maximum number of queued jobs. Applied in configureHook");
+
+    this->addAttribute("jobs_done", jobs_done);
+    this->addAttribute("jobs_failed", jobs_failed);
+
+    this->ports()->addPort(results_port).doc("results of submitted jobs: { id, 'ok' or 'error', result }");
+    results_port.setDataSample(result_sample);
+
+    this->addOperation("submit", &LuaWorkerPool::submit, this, ClientThread)
+      .doc("queue a call of a global Lua function. Returns the job id, or 0 if the job was not queued. The result is written to the results port")
+      .arg("func", "name of the function")
+      .arg("args", "string argument passed to the function");
+    this->addOperation("run", &LuaWorkerPool::run, this, ClientThread)
+      .doc("call a global Lua function in a worker and wait for its result. Returns false if the call failed")
+      .arg("func", "name of the function")
+      .arg("args", "string argument passed to the function")
+      .arg("result", "returned string, or the error message");
+    this->addOperation("queued", &LuaWorkerPool::queued, this, ClientThread)
+      .doc("number of jobs waiting for a worker");
+  }
+
+  LuaWorkerPool::~LuaWorkerPool()
+  {
+    if (this->isRunning())
+      this->stop();
+    destroy();
+  }
+
+  lua_State* LuaWorkerPool::create_state()
+  {
+    lua_State *L = luaL_newstate();
+    if (L == NULL)
+      return NULL;
+
+    lua_gc(L, LUA_GCSTOP, 0);
+    luaL_openlibs(L);
+    lua_gc(L, LUA_GCRESTART, 0);
+    chunkcache_install_loader(L);
+
+    lua_pushcfunction(L, luaopen_rtt);
+    lua_call(L, 0, 0);
+    set_context_tc(this, L);
+
+    if (!lua_file.empty() && chunkcache_dofile(L, lua_file.c_str()))
+      goto error;
+
+    if (!lua_string.empty() && luaL_dostring(L, lua_string.c_str()))
+      goto error;
+
+    return L;
+
+  error:
+    Logger::log(Logger::Error) << "LuaWorkerPool '" << this->getName() << "': " << lua_tostring(L, -1) << endlog();
+    lua_close(L);
+    return NULL;
+  }
+
+  bool LuaWorkerPool::configureHook()
+  {
+    destroy();
+
+    if (workers == 0) {
+      Logger::log(Logger::Error) << "LuaWorkerPool '" << this->getName() << "': workers must be at least 1" << endlog();
+      return false;
+    }
+
+    queue = new base::BufferLockFree<Job*>(queue_size);
+
+    for (unsigned int i = 0; i < workers; ++i) {
+      lua_State *L = create_state();
+      if (L == NULL) {
+        destroy();
+        return false;
+      }
+
+      std::stringstream name;
+      name << this->getName() << ".worker" << i;
+      Worker *w = new Worker(this, L);
+      states.push_back(L);
+      runners.push_back(w);
+      activities.push_back(new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.0, w, name.str()));
+    }
+    return true;
+  }
+
+  bool LuaWorkerPool::startHook()
+  {
+    stopping.set(0);
+    for (unsigned int i = 0; i < activities.size(); ++i) {
+      if (!activities[i]->start()) {
+        Logger::log(Logger::Error) << "LuaWorkerPool '" << this->getName() << "': failed to start worker " << i << endlog();
+        stopHook();
+        return false;
+      }
+    }
+    os::MutexLock lock(m);
+    accepting = true;
+    return true;
+  }
+
+  /* once accepting is reset, no job can be queued anymore, so the
+   * drain after the workers stopped fails all remaining jobs. */
+  void LuaWorkerPool::stopHook()
+  {
+    {
+      os::MutexLock lock(m);
+      accepting = false;
+    }
+    stopping.set(1);
+    for (unsigned int i = 0; i < activities.size(); ++i)
+      pending.signal();
+    for (unsigned int i = 0; i < activities.size(); ++i)
+      activities[i]->stop();
+    drain();
+  }
+
+  void LuaWorkerPool::cleanupHook()
+  {
+    destroy();
+  }
+
+  /* fail all jobs still in the queue */
+  void LuaWorkerPool::drain()
+  {
+    Job *job;
+    while (queue && queue->Pop(job)) {
+      job->ok = false;
+      job->result = "LuaWorkerPool stopped";
+      finish(job);
+    }
+  }
+
+  void LuaWorkerPool::destroy()
+  {
+    for (unsigned int i = 0; i < activities.size(); ++i) {
+      activities[i]->stop();
+      delete activities[i];
+    }
+    for (unsigned int i = 0; i < runners.size(); ++i)
+      delete runners[i];
+    for (unsigned int i = 0; i < states.size(); ++i)
+      lua_close(states[i]);
+    activities.clear();
+    runners.clear();
+    states.clear();
+
+    drain();
+    delete queue;
+    queue = 0;
+  }
+
+  /* returns the id of the queued job, or 0. Deletes the job if it
+   * could not be queued and nobody waits for it. */
+  unsigned int LuaWorkerPool::enqueue(Job *job)
+  {
+    {
+      os::MutexLock lock(m);
+      if (accepting && queue != 0) {
+        unsigned int id = ++next_id;
+        if (id == 0)
+          id = ++next_id;
+        job->id = id;
+        // after the push, the job belongs to the workers
+        if (queue->Push(job)) {
+          pending.signal();
+          return id;
+        }
+      }
+    }
+
+    if (job->done == 0)
+      delete job;
+    return 0;
+  }
+
+  unsigned int LuaWorkerPool::submit(const std::string &func, const std::string &args)
+  {
+    Job *job = new Job;
+    job->func = func;
+    job->args = args;
+    job->ok = false;
+    job->done = 0;
+    return enqueue(job);
+  }
+
+  bool LuaWorkerPool::run(const std::string &func, const std::string &args, std::string &result)
+  {
+    os::Semaphore done(0);
+    Job job;
+    job.func = func;
+    job.args = args;
+    job.ok = false;
+    job.done = &done;
+
+    if (enqueue(&job) == 0) {
+      result = this->isRunning() ? "LuaWorkerPool: queue full" : "LuaWorkerPool: not running";
+      return false;
+    }
+
+    done.wait();
+    result = job.result;
+    return job.ok;
+  }
+
+  unsigned int LuaWorkerPool::queued()
+  {
+    return queue ? queue->size() : 0;
+  }
+
+  /* called by the worker owning L */
+  void LuaWorkerPool::execute(lua_State *L, Job *job)
+  {
+    lua_settop(L, 0);
+    lua_getglobal(L, job->func.c_str());
+
+    if (!lua_isfunction(L, -1)) {
+      job->ok = false;
+      job->result = "no Lua function " + job->func;
+    } else {
+      lua_pushlstring(L, job->args.c_str(), job->args.size());
+      if (lua_pcall(L, 1, 1, 0)) {
+        job->ok = false;
+        job->result = lua_tostring(L, -1) ? lua_tostring(L, -1) : "unknown error";
+      } else if (lua_isnil(L, -1)) {
+        job->ok = true;
+        job->result.clear();
+      } else if (lua_isstring(L, -1)) {
+        size_t len;
+        const char *s = lua_tolstring(L, -1, &len);
+        job->ok = true;
+        job->result.assign(s, len);
+      } else {
+        job->ok = false;
+        job->result = job->func + " must return a string, not " + lua_typename(L, lua_type(L, -1));
+      }
+    }
+
+    lua_settop(L, 0);
+    finish(job);
+  }
+
+  void LuaWorkerPool::finish(Job *job)
+  {
+    os::MutexLock lock(m);
+
+    if (job->ok)
+      ++jobs_done;
+    else
+      ++jobs_failed;
+
+    if (job->done) {
+      // the job belongs to the caller of run()
+      job->done->signal();
+      return;
+    }
+
+    std::stringstream id;
+    id << job->id;
+    result_sample[0] = id.str();
+    result_sample[1] = job->ok ? "ok" : "error";
+    result_sample[2] = job->result;
+    results_port.write(result_sample);
+    delete job;
+  }
+
+} // namespace OCL
+
+#include "ocl/Component.hpp"
+ORO_CREATE_COMPONENT( OCL::LuaWorkerPool )
@@ -0,0 +1,120 @@
+/*
+ * Lua-RTT bindings. LuaWorkerPool.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation;
+ * version 2 of the License.
+ *
+ * As a special exception, you may use this file as part of a free
+ * software library without restriction.  Specifically, if other files
+ * instantiate templates or use macros or inline functions from this
+ * file, or you compile this file and link it with other files to
+ * produce an executable, this file does not by itself cause the
+ * resulting executable to be covered by the GNU General Public
+ * License.  This exception does not however invalidate any other
+ * reasons why the executable file might be covered by the GNU General
+ * Public License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place,
+ * Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OCL_LUAWORKERPOOL_HPP
+#define OCL_LUAWORKERPOOL_HPP
+
+#include <string>
+#include <vector>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/Semaphore.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/base/BufferLockFree.hpp>
+#include <rtt/base/ActivityInterface.hpp>
+#include <rtt/TaskContext.hpp>
+#include <rtt/OutputPort.hpp>
+
+struct lua_State;
+
+namespace OCL
+{
+  /**
+   * Runs Lua functions in parallel in a number of independent Lua
+   * states, each with its own thread. Every state loads the same
+   * lua_file and lua_string when the component is configured, and
+   * has the rtt bindings with this component as its TaskContext.
+   *
+   * A job is the name of a global function plus a string argument,
+   * for instance serialized with a Lua serializer. The function must
+   * return a string (or nothing). Jobs are passed to the workers
+   * through a lock-free queue. The result is either written to the
+   * results port (submit) or returned to the caller, which blocks
+   * until the job is done (run).
+   */
+  class LuaWorkerPool : public RTT::TaskContext
+  {
+  protected:
+    struct Job {
+      unsigned int id;
+      std::string func;
+      std::string args;
+      std::string result;
+      bool ok;
+      /* set if a caller of run() waits for this job */
+      RTT::os::Semaphore *done;
+    };
+
+    class Worker;
+
+    std::string lua_string;
+    std::string lua_file;
+    unsigned int workers;
+    unsigned int queue_size;
+
+    std::vector<lua_State*> states;
+    std::vector<RTT::base::ActivityInterface*> activities;
+    std::vector<Worker*> runners;
+
+    RTT::base::BufferLockFree<Job*> *queue;
+    RTT::os::Semaphore pending;
+    RTT::os::AtomicInt stopping;
+    RTT::os::Mutex m;
+    /* jobs are only queued while set, protected by m */
+    bool accepting;
+
+    unsigned int next_id;
+    unsigned int jobs_done;
+    unsigned int jobs_failed;
+
+    RTT::OutputPort<std::vector<std::string> > results_port;
+    std::vector<std::string> result_sample;
+
+    lua_State* create_state();
+    unsigned int enqueue(Job *job);
+    void execute(lua_State *L, Job *job);
+    void finish(Job *job);
+    void drain();
+    void destroy();
+
+  public:
+    LuaWorkerPool(std::string name);
+    ~LuaWorkerPool();
+
+    unsigned int submit(const std::string &func, const std::string &args);
+    bool run(const std::string &func, const std::string &args, std::string &result);
+    unsigned int queued();
+
+    bool configureHook();
+    bool startHook();
+    void stopHook();
+    void cleanupHook();
+  };
+} // namespace OCL
+
+#endif
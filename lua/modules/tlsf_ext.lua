@@ -8,8 +8,8 @@ module ("tlsf_ext")
 
 --- Pretty print memory status.
 function info()
-   local cur, max, tot = tlsf.stats()
-   print(("tlsf stats: cur=%d (%d%s), max=%d (%d%s), total=%d"):format(cur, ((cur * 100) / tot), '%', max, (max * 100) / tot, '%', tot))
+   local cur, max, tot, largest, failed = tlsf.stats()
+   print(("tlsf stats: cur=%d (%d%s), max=%d (%d%s), total=%d, largest free=%d, failed allocs=%d"):format(cur, ((cur * 100) / tot), '%', max, (max * 100) / tot, '%', tot, largest, failed))
 end
 
 
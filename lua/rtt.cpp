@@ -33,6 +33,13 @@
  */
 
 #include "rtt.hpp"
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
 
 using namespace std;
 using namespace RTT;
@@ -219,42 +226,227 @@ static const TypeInfo* ti_lookup(lua_State *L, const char *name)
 #endif /* TYPEINFO_CACHING */
 }
 
-/* helper, check if a type name is an alias to the given TypeInfo */
-static bool __typenames_cmp(lua_State *L, const types::TypeInfo *ti1, const char* type2)
+/***************************************************************
+ * Conversion of basic types
+ *
+ * Each lua_State keeps a table REG[&conv_cache_key] that maps a
+ * TypeInfo (as lightuserdata) to its converter (lightuserdata) or to
+ * false if the type has no converter. It is filled the first time a
+ * TypeInfo is seen, so looking up the converter of a Variable costs
+ * two table lookups, whatever the number of basic types. Element 1
+ * holds the generation of the converter registry the table was built
+ * with; registering a converter invalidates all caches.
+ ***************************************************************/
+
+static void conv_narrow_err(lua_State *L, DataSourceBase *ds)
 {
-	const types::TypeInfo *ti2 = ti_lookup(L, type2);
-	return ti1 == ti2;
+	luaL_error(L, "Variable.tolua: narrow failed for %s Variable", ds->getTypeName().c_str());
 }
 
-/* helper, check if a dsb is of type type. Works also if dsb is known
-   under an alias of type */
-static bool Variable_is_a(lua_State *L, const types::TypeInfo *ti1, const char* type)
+static void conv_assign_err(lua_State *L, DataSourceBase *ds)
 {
-	const types::TypeInfo *ti2 = ti_lookup(L, type);
-	return ti1 == ti2;
+	luaL_error(L, "Variable_fromlua: failed to narrow target dsb to %s", ds->getTypeName().c_str());
 }
 
-/* helper, check if a variable is basic, that is _tolua will succeed */
-static bool __Variable_isbasic(lua_State *L, DataSourceBase::shared_ptr &dsb)
+template<typename T>
+static void number_tolua(lua_State *L, DataSourceBase *ds)
 {
-	const types::TypeInfo *ti = dsb->getTypeInfo();
-
-	if ( Variable_is_a(L, ti, "bool") ||
-	     Variable_is_a(L, ti, "double") ||
-	     Variable_is_a(L, ti, "float") ||
-	     Variable_is_a(L, ti, "uint") ||
-	     Variable_is_a(L, ti, "int") ||
-	     Variable_is_a(L, ti, "long") ||
-	     Variable_is_a(L, ti, "char") ||
-	     Variable_is_a(L, ti, "uint8") || Variable_is_a(L, ti, "int8") ||
-	     Variable_is_a(L, ti, "uint16") || Variable_is_a(L, ti, "int16") ||
-	     Variable_is_a(L, ti, "uint32") || Variable_is_a(L, ti, "int32") ||
-	     Variable_is_a(L, ti, "uint64") || Variable_is_a(L, ti, "int64") ||
-	     Variable_is_a(L, ti, "string") ||
-	     Variable_is_a(L, ti, "void"))
-		return true;
+	DataSource<T>* d = DataSource<T>::narrow(ds);
+	if(!d) conv_narrow_err(L, ds);
+	lua_pushnumber(L, (lua_Number) d->get());
+}
+
+template<typename T>
+static bool number_fromlua(lua_State *L, DataSourceBase *ds, int valind)
+{
+	if(lua_type(L, valind) != LUA_TNUMBER)
+		return false;
+	AssignableDataSource<T> *ads = ValueDataSource<T>::narrow(ds);
+	if(!ads) conv_assign_err(L, ds);
+	ads->set((T) lua_tonumber(L, valind));
+	return true;
+}
+
+static void bool_tolua(lua_State *L, DataSourceBase *ds)
+{
+	DataSource<bool>* d = DataSource<bool>::narrow(ds);
+	if(!d) conv_narrow_err(L, ds);
+	lua_pushboolean(L, d->get());
+}
+
+static bool bool_fromlua(lua_State *L, DataSourceBase *ds, int valind)
+{
+	lua_Number x;
+	int luatype = lua_type(L, valind);
+
+	if(luatype == LUA_TBOOLEAN)
+		x = (lua_Number) lua_toboolean(L, valind);
+	else if (luatype == LUA_TNUMBER)
+		x = lua_tonumber(L, valind);
 	else
 		return false;
+
+	AssignableDataSource<bool> *ads = ValueDataSource<bool>::narrow(ds);
+	if(!ads) conv_assign_err(L, ds);
+	ads->set((bool) x);
+	return true;
+}
+
+static void char_tolua(lua_State *L, DataSourceBase *ds)
+{
+	DataSource<char>* d = DataSource<char>::narrow(ds);
+	if(!d) conv_narrow_err(L, ds);
+	char c = d->get();
+	lua_pushlstring(L, &c, 1);
+}
+
+static bool char_fromlua(lua_State *L, DataSourceBase *ds, int valind)
+{
+	if(lua_type(L, valind) != LUA_TSTRING)
+		return false;
+	AssignableDataSource<char> *ads = ValueDataSource<char>::narrow(ds);
+	if(!ads) conv_assign_err(L, ds);
+	ads->set((char) lua_tostring(L, valind)[0]);
+	return true;
+}
+
+static void string_tolua(lua_State *L, DataSourceBase *ds)
+{
+	DataSource<std::string>* d = DataSource<std::string>::narrow(ds);
+	if(!d) conv_narrow_err(L, ds);
+	/* evaluate and refer to the stored value, get() would copy it */
+	d->evaluate();
+	const std::string& str = d->rvalue();
+	lua_pushlstring(L, str.c_str(), str.size());
+}
+
+static bool string_fromlua(lua_State *L, DataSourceBase *ds, int valind)
+{
+	size_t l;
+	const char *x;
+	if(lua_type(L, valind) != LUA_TSTRING)
+		return false;
+	x = lua_tolstring(L, valind, &l);
+	AssignableDataSource<std::string> *ads = ValueDataSource<std::string>::narrow(ds);
+	if(!ads) conv_assign_err(L, ds);
+	ads->set().assign(x, l);
+	return true;
+}
+
+static void void_tolua(lua_State *L, DataSourceBase *ds)
+{
+	if(!DataSource<void>::narrow(ds)) conv_narrow_err(L, ds);
+	lua_pushnil(L);
+}
+
+static bool void_fromlua(lua_State *L, DataSourceBase *ds, int valind)
+{
+	return false;
+}
+
+static const struct {
+	const char *name;
+	VariableConv conv;
+} basic_convs [] = {
+	{ "bool", { bool_tolua, bool_fromlua } },
+	{ "double", { number_tolua<double>, number_fromlua<double> } },
+	{ "float", { number_tolua<float>, number_fromlua<float> } },
+	{ "uint", { number_tolua<unsigned int>, number_fromlua<unsigned int> } },
+	{ "int", { number_tolua<int>, number_fromlua<int> } },
+	{ "long", { number_tolua<long>, number_fromlua<long> } },
+	{ "uint8", { number_tolua<uint8_t>, number_fromlua<uint8_t> } },
+	{ "int8", { number_tolua<int8_t>, number_fromlua<int8_t> } },
+	{ "uint16", { number_tolua<uint16_t>, number_fromlua<uint16_t> } },
+	{ "int16", { number_tolua<int16_t>, number_fromlua<int16_t> } },
+	{ "uint32", { number_tolua<uint32_t>, number_fromlua<uint32_t> } },
+	{ "int32", { number_tolua<int32_t>, number_fromlua<int32_t> } },
+	{ "uint64", { number_tolua<uint64_t>, number_fromlua<uint64_t> } },
+	{ "int64", { number_tolua<int64_t>, number_fromlua<int64_t> } },
+	{ "char", { char_tolua, char_fromlua } },
+	{ "string", { string_tolua, string_fromlua } },
+	{ "void", { void_tolua, void_fromlua } },
+	{ NULL, { NULL, NULL } }
+};
+
+/* slowpath: find the converter of ti by comparing with the TypeInfo
+ * of each known type name, so that aliases are found too. The
+ * registered converters are copied first, ti_lookup may raise a Lua
+ * error. */
+static const VariableConv* conv_resolve(lua_State *L, const types::TypeInfo *ti)
+{
+	VariableConvList extra = Variable_converters();
+	for(VariableConvList::const_iterator it = extra.begin(); it != extra.end(); ++it)
+		if(ti_lookup(L, it->first.c_str()) == ti)
+			return it->second;
+
+	for(int i=0; basic_convs[i].name != NULL; i++)
+		if(ti_lookup(L, basic_convs[i].name) == ti)
+			return &basic_convs[i].conv;
+
+	return NULL;
+}
+
+static char conv_cache_key;
+
+/* return the converter for ti or NULL if ti is not a basic type */
+static const VariableConv* conv_lookup(lua_State *L, const types::TypeInfo *ti)
+{
+	const VariableConv *conv;
+	int top = lua_gettop(L);
+	int gen = Variable_converters_generation();
+
+	lua_pushlightuserdata(L, (void*) &conv_cache_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+
+	if(lua_type(L, -1) == LUA_TTABLE) {
+		lua_rawgeti(L, -1, 1);
+		if(lua_tointeger(L, -1) == gen) {
+			lua_pop(L, 1);
+			goto table_on_top;
+		}
+	}
+
+	/* first lookup or outdated, (re)create table */
+	lua_settop(L, top);
+	lua_newtable(L);
+	lua_pushinteger(L, gen);
+	lua_rawseti(L, -2, 1);
+	lua_pushlightuserdata(L, (void*) &conv_cache_key);
+	lua_pushvalue(L, -2);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+
+ table_on_top:
+	lua_pushlightuserdata(L, (void*) ti);
+	lua_rawget(L, -2);
+
+	if(lua_type(L, -1) == LUA_TLIGHTUSERDATA) {
+		conv = (const VariableConv*) lua_touserdata(L, -1);
+		goto out;
+	} else if (lua_type(L, -1) == LUA_TBOOLEAN) {
+		conv = NULL;
+		goto out;
+	}
+
+	/* cache miss */
+	lua_pop(L, 1);
+	conv = conv_resolve(L, ti);
+	lua_pushlightuserdata(L, (void*) ti);
+	if(conv)
+		lua_pushlightuserdata(L, (void*) conv);
+	else
+		lua_pushboolean(L, 0);
+	lua_rawset(L, -3);
+
+ out:
+	lua_settop(L, top);
+	return conv;
+}
+
+/* helper, check if a variable is basic, that is _tolua will succeed */
+static bool __Variable_isbasic(lua_State *L, DataSourceBase::shared_ptr &dsb)
+{
+	const VariableConv *conv = conv_lookup(L, dsb->getTypeInfo());
+	return conv && conv->tolua;
 }
 
 static int Variable_isbasic(lua_State *L)
@@ -272,92 +464,14 @@ static int Variable_isbasic(lua_State *L)
 static int __Variable_tolua(lua_State *L, DataSourceBase::shared_ptr dsb)
 {
 	DataSourceBase *ds = dsb.get();
-	const types::TypeInfo* ti = dsb->getTypeInfo();
 	assert(ds);
+	const VariableConv *conv = conv_lookup(L, ds->getTypeInfo());
 
-	if(Variable_is_a(L, ti, "bool")) { // bool
-		DataSource<bool>* dsb = DataSource<bool>::narrow(ds);
-		if(dsb) lua_pushboolean(L, dsb->get());
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "float")) { // float
-		DataSource<float>* dsb = DataSource<float>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "double")) { // double
-		DataSource<double>* dsb = DataSource<double>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "uint8")) { // uint8_t
-		DataSource<uint8_t>* dsb = DataSource<uint8_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "int8")) { // int8_t
-		DataSource<int8_t>* dsb = DataSource<int8_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "uint16")) { // uint16_t
-		DataSource<uint16_t>* dsb = DataSource<uint16_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "int16")) { // int16_t
-		DataSource<int16_t>* dsb = DataSource<int16_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "uint32")) { // uint32_t
-		DataSource<uint32_t>* dsb = DataSource<uint32_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "int32")) { // int32_t
-		DataSource<int32_t>* dsb = DataSource<int32_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "uint64")) { // uint64_t
-		DataSource<uint64_t>* dsb = DataSource<uint64_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "int64")) { // int64_t
-		DataSource<int64_t>* dsb = DataSource<int64_t>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "uint")) { // uint
-		DataSource<unsigned int>* dsb = DataSource<unsigned int>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "long")) { //long
-		DataSource<long>* dsb = DataSource<long>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "int")) { // int
-		DataSource<int>* dsb = DataSource<int>::narrow(ds);
-		if(dsb) lua_pushnumber(L, ((lua_Number) dsb->get()));
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "char")) { // char
-		DataSource<char>* dsb = DataSource<char>::narrow(ds);
-		char c = dsb->get();
-		if(dsb) lua_pushlstring(L, &c, 1);
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "string")) { //string
-		DataSource<std::string>* dsb = DataSource<std::string>::narrow(ds);
-		if(dsb) lua_pushlstring(L, dsb->get().c_str(), dsb->get().size());
-		else goto out_nodsb;
-	} else if (Variable_is_a(L, ti, "void")) {
-		DataSource<void>* dsb = DataSource<void>::narrow(ds);
-		if(dsb) lua_pushnil(L);
-		else goto out_nodsb;
-	} else {
-		goto out_conv_err;
-	}
+	if(!conv || !conv->tolua)
+		luaL_error(L, "Variable.tolua: can't convert type %s", dsb->getTypeName().c_str());
 
-	/* all ok */
+	conv->tolua(L, ds);
 	return 1;
-
- out_conv_err:
-	luaL_error(L, "Variable.tolua: can't convert type %s", dsb->getTypeName().c_str());
-	return 0;
-
- out_nodsb:
-	luaL_error(L, "Variable.tolua: narrow failed for %s Variable", dsb->getTypeName().c_str());
-	return 0;
 }
 
 static int Variable_tolua(lua_State *L)
@@ -541,79 +655,21 @@ static int Variable_create(lua_State *L)
 	return 1;
 }
 
-#define CONVERT_TO_NUMBER(CTGT) \
-	lua_Number x; \
-	if (luatype == LUA_TNUMBER) x = lua_tonumber(L, valind); \
-	else goto out_conv_err; \
-	AssignableDataSource<CTGT> *ads = ValueDataSource<CTGT>::narrow(dsb.get()); \
-	if (ads == NULL) luaL_error(L, "Variable_fromlua: failed to narrow target dsb to %s.", #CTGT ); \
-	ads->set((CTGT) x)\
-
 /* Try to convert the Lua value on stack at valind to given DSB
  * if it returns, evertthing is ok */
 static void Variable_fromlua(lua_State *L, DataSourceBase::shared_ptr& dsb, int valind)
 {
 	const types::TypeInfo* ti = dsb->getTypeInfo();
+	const VariableConv *conv;
 
 	luaL_checkany(L, valind);
-	int luatype = lua_type(L, valind); 	/* type of lua variable */
-
-	if(__typenames_cmp(L, ti, "bool")) {
-		lua_Number x;
-		if(luatype == LUA_TBOOLEAN)
-			x = (lua_Number) lua_toboolean(L, valind);
-		else if (luatype == LUA_TNUMBER)
-			x = lua_tonumber(L, valind);
-		else
-			goto out_conv_err;
-
-		AssignableDataSource<bool> *ads = ValueDataSource<bool>::narrow(dsb.get());
-		if (ads == NULL)
-			luaL_error(L, "Variable_fromlua: failed to narrow target dsb to bool");
-		ads->set((bool) x);
-	}
-	else if (__typenames_cmp(L, ti, "uint"))   { CONVERT_TO_NUMBER(unsigned int); }
-	else if (__typenames_cmp(L, ti, "int"))    { CONVERT_TO_NUMBER(int); }
-	else if (__typenames_cmp(L, ti, "double")) { CONVERT_TO_NUMBER(double); }
-	else if (__typenames_cmp(L, ti, "long"))   { CONVERT_TO_NUMBER(double); }
-	else if (__typenames_cmp(L, ti, "uint8"))  { CONVERT_TO_NUMBER(uint8_t); }
-	else if (__typenames_cmp(L, ti, "int8"))   { CONVERT_TO_NUMBER(int8_t); }
-	else if (__typenames_cmp(L, ti, "uint16")) { CONVERT_TO_NUMBER(uint16_t); }
-	else if (__typenames_cmp(L, ti, "int16"))  { CONVERT_TO_NUMBER(int16_t); }
-	else if (__typenames_cmp(L, ti, "uint32")) { CONVERT_TO_NUMBER(uint32_t); }
-	else if (__typenames_cmp(L, ti, "int32"))  { CONVERT_TO_NUMBER(int32_t); }
-	else if (__typenames_cmp(L, ti, "uint64")) { CONVERT_TO_NUMBER(uint64_t); }
-	else if (__typenames_cmp(L, ti, "int64"))  { CONVERT_TO_NUMBER(int64_t); }
-	else if (__typenames_cmp(L, ti, "float"))  { CONVERT_TO_NUMBER(float); }
-
-	else if (__typenames_cmp(L, ti, "char")) {
-		const char *x;
-		size_t l;
-		if (luatype == LUA_TSTRING) x = lua_tolstring(L, valind, &l);
-		else goto out_conv_err;
-		AssignableDataSource<char> *ads = ValueDataSource<char>::narrow(dsb.get());
-		if (ads == NULL) luaL_error(L, "Variable_fromlua: failed to narrow target dsb to char");
-		ads->set((char) x[0]);
-
-	} else if (__typenames_cmp(L, ti, "string")) {
-		const char *x;
-		if (luatype == LUA_TSTRING) x = lua_tostring(L, valind);
-		else goto out_conv_err;
-		AssignableDataSource<std::string> *ads = ValueDataSource<std::string>::narrow(dsb.get());
-		if (ads == NULL) luaL_error(L, "Variable_fromlua: failed to narrow target dsb to std::string");
-		ads->set((std::string) x);
 
-	} else {
-		goto out_conv_err;
-	}
-
-	/* everybody happy */
-	return;
+	conv = conv_lookup(L, ti);
+	if(conv && conv->fromlua && conv->fromlua(L, dsb.get(), valind))
+		return;
 
- out_conv_err:
 	luaL_error(L, "__lua_todsb: can't convert lua %s to %s variable",
-		   lua_typename(L, luatype), ti->getTypeName().c_str());
-	return;
+		   lua_typename(L, lua_type(L, valind)), ti->getTypeName().c_str());
 }
 
 /* Create a DSB of RTT ti from the Lua value at stack[valind]
@@ -694,6 +750,8 @@ static int Variable_resize(lua_State *L)
 	DataSourceBase::shared_ptr *dsbp = luaM_checkudata_mt(L, 1, "Variable", DataSourceBase::shared_ptr);
 	size = luaL_checknumber(L, 2);
 	const TypeInfo *ti = (*dsbp)->getTypeInfo();
+	/* cached members may point into the old storage */
+	cache_clear(L, dsbp->get());
 	lua_pushboolean(L, ti->resize(*dsbp, size));
 	return 1;
 }
@@ -818,6 +876,186 @@ static int Variable_newindex(lua_State *L)
 	return 1;
 }
 
+/*
+ * VariablePath: a member path like "pose.position.x" resolved once
+ * against a root Variable. get and set then only touch the leaf
+ * DataSource. Members of sequence elements point into the sequence
+ * storage, so for each hop below a sequence the capacity and size are
+ * checked on access and the path is re-resolved from that hop when
+ * the sequence was reallocated.
+ */
+struct VariablePathHop {
+	std::string name;
+	DataSourceBase::shared_ptr dsb;
+	/* only set if this hop is an element of a sequence */
+	DataSource<int>::shared_ptr size;
+	DataSource<int>::shared_ptr capacity;
+	int cap;
+	int index;
+};
+
+struct VariablePath {
+	DataSourceBase::shared_ptr root;
+	std::vector<VariablePathHop> hops;
+	const VariableConv *conv;
+	int conv_gen;
+};
+
+static bool path_is_index(const std::string& s)
+{
+	if(s.empty())
+		return false;
+	for(std::string::size_type i=0; i<s.size(); i++)
+		if(s[i] < '0' || s[i] > '9')
+			return false;
+	return true;
+}
+
+/* (re)resolve the hops starting at from */
+static void path_resolve(lua_State *L, VariablePath *vp, unsigned int from)
+{
+	DataSourceBase::shared_ptr parent;
+
+	for(unsigned int i=from; i<vp->hops.size(); i++) {
+		VariablePathHop& h = vp->hops[i];
+		parent = (i == 0) ? vp->root : vp->hops[i-1].dsb;
+
+		h.dsb = 0;
+		h.size = 0;
+		h.capacity = 0;
+
+		if(path_is_index(h.name)) {
+			h.size = DataSource<int>::narrow(parent->getMember("size").get());
+			h.capacity = DataSource<int>::narrow(parent->getMember("capacity").get());
+			h.index = atoi(h.name.c_str());
+			h.cap = (h.capacity) ? h.capacity->get() : 0;
+		}
+
+		h.dsb = parent->getMember(h.name);
+		if(h.dsb == 0)
+			luaL_error(L, "VariablePath: indexing failed, no member %s in %s",
+				   h.name.c_str(), parent->getTypeName().c_str());
+	}
+
+	vp->conv_gen = Variable_converters_generation();
+	vp->conv = conv_lookup(L, vp->hops.back().dsb->getTypeInfo());
+}
+
+/* return the leaf dsb, re-resolving stale hops first */
+static DataSourceBase* path_leaf(lua_State *L, VariablePath *vp)
+{
+	for(unsigned int i=0; i<vp->hops.size(); i++) {
+		VariablePathHop& h = vp->hops[i];
+
+		if(h.dsb == 0) {
+			path_resolve(L, vp, i);
+			break;
+		}
+
+		if(!h.size)
+			continue;
+
+		if(h.index >= h.size->get())
+			luaL_error(L, "VariablePath: index %d out of range", h.index);
+
+		if(h.capacity && h.capacity->get() != h.cap) {
+			path_resolve(L, vp, i);
+			break;
+		}
+	}
+
+	int gen = Variable_converters_generation();
+	if(vp->conv_gen != gen) {
+		vp->conv_gen = gen;
+		vp->conv = conv_lookup(L, vp->hops.back().dsb->getTypeInfo());
+	}
+
+	return vp->hops.back().dsb.get();
+}
+
+static int Variable_path(lua_State *L)
+{
+	DataSourceBase::shared_ptr *dsbp = luaM_checkudata_mt(L, 1, "Variable", DataSourceBase::shared_ptr);
+	std::string path = luaL_checkstring(L, 2);
+	std::string::size_type start = 0, end;
+	VariablePath *vp;
+
+	vp = luaM_pushobject_mt(L, "VariablePath", VariablePath)();
+	vp->root = *dsbp;
+
+	do {
+		end = path.find('.', start);
+		VariablePathHop h;
+		h.name = path.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+		if(h.name.empty())
+			luaL_error(L, "Variable.path: invalid path '%s'", path.c_str());
+		vp->hops.push_back(h);
+		start = end + 1;
+	} while(end != std::string::npos);
+
+	path_resolve(L, vp, 0);
+	return 1;
+}
+
+static int VariablePath_get(lua_State *L)
+{
+	VariablePath *vp = luaM_checkudata_mt(L, 1, "VariablePath", VariablePath);
+	DataSourceBase *leaf = path_leaf(L, vp);
+
+	if(vp->conv && vp->conv->tolua)
+		vp->conv->tolua(L, leaf);
+	else
+		luaM_pushobject_mt(L, "Variable", DataSourceBase::shared_ptr)(leaf);
+	return 1;
+}
+
+static int VariablePath_getRaw(lua_State *L)
+{
+	VariablePath *vp = luaM_checkudata_mt(L, 1, "VariablePath", VariablePath);
+	luaM_pushobject_mt(L, "Variable", DataSourceBase::shared_ptr)(path_leaf(L, vp));
+	return 1;
+}
+
+static int VariablePath_set(lua_State *L)
+{
+	DataSourceBase::shared_ptr *newvalp;
+	VariablePath *vp = luaM_checkudata_mt(L, 1, "VariablePath", VariablePath);
+	DataSourceBase *leaf = path_leaf(L, vp);
+
+	luaL_checkany(L, 2);
+
+	if ((newvalp = luaM_testudata_mt(L, 2, "Variable", DataSourceBase::shared_ptr)) != NULL) {
+		if(!leaf->update(newvalp->get()))
+			luaL_error(L, "VariablePath.set: failed to assign %s to member of type %s",
+				   (*newvalp)->getType().c_str(), leaf->getType().c_str());
+	} else if(!vp->conv || !vp->conv->fromlua || !vp->conv->fromlua(L, leaf, 2)) {
+		luaL_error(L, "VariablePath.set: can't convert lua %s to %s",
+			   lua_typename(L, lua_type(L, 2)), leaf->getTypeName().c_str());
+	}
+	return 0;
+}
+
+static int VariablePath_toString(lua_State *L)
+{
+	VariablePath *vp = luaM_checkudata_mt(L, 1, "VariablePath", VariablePath);
+	std::string s;
+
+	for(unsigned int i=0; i<vp->hops.size(); i++)
+		s += (i ? "." : "") + vp->hops[i].name;
+
+	lua_pushstring(L, s.c_str());
+	return 1;
+}
+
+static const struct luaL_Reg VariablePath_m [] = {
+	{ "get", VariablePath_get },
+	{ "getRaw", VariablePath_getRaw },
+	{ "set", VariablePath_set },
+	{ "__tostring", VariablePath_toString },
+	{ "__gc", GCMethod<VariablePath> },
+	{ NULL, NULL}
+};
+
 // Why doesn't the following work:
 // static int Variable_gc(lua_State *L)
 // {
@@ -851,6 +1089,7 @@ static const struct luaL_Reg Variable_f [] = {
 	{ "getMemberRaw", Variable_getMemberRaw },
 	{ "tolud", Variable_tolightuserdata },
 	{ "resize", Variable_resize },
+	{ "path", Variable_path },
 	{ "opBinary", Variable_opBinary },
 	{ "assign", Variable_update }, /* assign seems a better name than update */
 	{ "unm", Variable_unm },
@@ -878,6 +1117,7 @@ static const struct luaL_Reg Variable_m [] = {
 	{ "getMemberRaw", Variable_getMemberRaw },
 	{ "tolud", Variable_tolightuserdata },
 	{ "resize", Variable_resize },
+	{ "path", Variable_path },
 	{ "opBinary", Variable_opBinary },
 	{ "assign", Variable_update }, /* assign seems a better name than update */
 	{ "__unm", Variable_unm },
@@ -1312,6 +1552,186 @@ static int Port_disconnect(lua_State *L)
 
 
 
+/***************************************************************
+ * Port samples
+ *
+ * Each port used from Lua gets a sample DataSource that is reused by
+ * every read and write, so that transferring basic values does not
+ * allocate. For struct types, the member DataSources of the sample
+ * are looked up once and used to fill or read plain Lua tables in
+ * place. The samples are kept in REG[&port_sample_key][port], which
+ * has weak values: each Lua handle of a port refers to the sample
+ * from its environment, so the sample of a port deleted outside Lua
+ * is collected with the last handle of that port.
+ ***************************************************************/
+
+struct PortField {
+	std::string name;
+	DataSourceBase::shared_ptr dsb;
+	const VariableConv *conv;		/* NULL if not basic */
+	std::vector<PortField> members;		/* empty if not a struct */
+};
+
+struct PortSample {
+	DataSourceBase::shared_ptr sample;
+	PortField root;
+};
+
+static char port_sample_key;
+
+/* sequences can change size, so their members are not cached */
+static void port_field_build(lua_State *L, PortField& f, int depth)
+{
+	f.conv = conv_lookup(L, f.dsb->getTypeInfo());
+	if(f.conv || depth > 16)
+		return;
+
+	std::vector<std::string> names = f.dsb->getMemberNames();
+	if(std::find(names.begin(), names.end(), "size") != names.end())
+		return;
+
+	for(std::vector<std::string>::iterator it = names.begin(); it != names.end(); ++it) {
+		DataSourceBase::shared_ptr m = f.dsb->getMember(*it);
+		if(!m)
+			continue;
+		f.members.push_back(PortField());
+		f.members.back().name = *it;
+		f.members.back().dsb = m;
+		port_field_build(L, f.members.back(), depth+1);
+	}
+}
+
+/* return the sample of port pi, create it on first use. ud is the
+ * index of the Lua handle of pi, which keeps the sample alive. */
+static PortSample* port_sample(lua_State *L, PortInterface *pi, int ud)
+{
+	PortSample *ps;
+	int top = lua_gettop(L);
+
+	lua_pushlightuserdata(L, (void*) &port_sample_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+
+	if(lua_type(L, -1) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushliteral(L, "v");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_pushlightuserdata(L, (void*) &port_sample_key);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+
+	lua_pushlightuserdata(L, (void*) pi);
+	lua_rawget(L, -2);
+
+	/* a port at the same address but of another type replaces a deleted one */
+	ps = luaM_testudata_mt(L, -1, "PortSample", PortSample);
+	if(ps && ps->sample->getTypeInfo() == pi->getTypeInfo())
+		goto out;
+
+	lua_pop(L, 1);
+	lua_pushlightuserdata(L, (void*) pi);
+	ps = luaM_pushobject_mt(L, "PortSample", PortSample)();
+	ps->sample = pi->getTypeInfo()->buildValue();
+	ps->root.dsb = ps->sample;
+	port_field_build(L, ps->root, 0);
+	lua_rawset(L, -3);
+
+	lua_pushlightuserdata(L, (void*) pi);
+	lua_rawget(L, -2);
+
+ out:
+	/* let the handle refer to the sample, unless it already does */
+	lua_getfenv(L, ud);
+	lua_pushlightuserdata(L, (void*) &port_sample_key);
+	lua_rawget(L, -2);
+	if(!lua_rawequal(L, -1, -3)) {
+		lua_createtable(L, 0, 1);
+		lua_pushlightuserdata(L, (void*) &port_sample_key);
+		lua_pushvalue(L, -5);
+		lua_rawset(L, -3);
+		lua_setfenv(L, ud);
+	}
+	lua_settop(L, top);
+	return ps;
+}
+
+static void port_sample_clear(lua_State *L, PortInterface *pi)
+{
+	lua_pushlightuserdata(L, (void*) &port_sample_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if(lua_type(L, -1) == LUA_TTABLE) {
+		lua_pushlightuserdata(L, (void*) pi);
+		lua_pushnil(L);
+		lua_rawset(L, -3);
+	}
+	lua_pop(L, 1);
+}
+
+/* store the members of f in the table at tabind, reusing subtables */
+static void port_field_totable(lua_State *L, PortField& f, int tabind)
+{
+	DataSourceBase::shared_ptr *dsbp;
+
+	for(std::vector<PortField>::iterator it = f.members.begin(); it != f.members.end(); ++it) {
+		lua_pushlstring(L, it->name.data(), it->name.size());
+
+		if(it->conv) {
+			it->conv->tolua(L, it->dsb.get());
+		} else if(!it->members.empty()) {
+			lua_pushvalue(L, -1);
+			lua_rawget(L, tabind);
+			if(lua_type(L, -1) != LUA_TTABLE) {
+				lua_pop(L, 1);
+				lua_newtable(L);
+			}
+			port_field_totable(L, *it, lua_gettop(L));
+		} else {
+			/* a Variable aliasing the member of the sample */
+			lua_pushvalue(L, -1);
+			lua_rawget(L, tabind);
+			dsbp = luaM_testudata_mt(L, -1, "Variable", DataSourceBase::shared_ptr);
+			if(!dsbp || dsbp->get() != it->dsb.get()) {
+				lua_pop(L, 1);
+				luaM_pushobject_mt(L, "Variable", DataSourceBase::shared_ptr)(it->dsb);
+			}
+		}
+		lua_rawset(L, tabind);
+	}
+}
+
+/* assign the fields of the table at tabind to the members of f. Fields
+ * which are not in the table keep their value. */
+static void port_field_fromtable(lua_State *L, PortField& f, int tabind)
+{
+	DataSourceBase::shared_ptr *dsbp;
+
+	for(std::vector<PortField>::iterator it = f.members.begin(); it != f.members.end(); ++it) {
+		lua_pushlstring(L, it->name.data(), it->name.size());
+		lua_rawget(L, tabind);
+
+		if(lua_isnil(L, -1)) {
+			/* keep */
+		} else if(it->conv) {
+			if(!it->conv->fromlua || !it->conv->fromlua(L, it->dsb.get(), lua_gettop(L)))
+				luaL_error(L, "OutputPort.write: can't convert lua %s to %s member %s",
+					   luaL_typename(L, -1), it->dsb->getTypeName().c_str(), it->name.c_str());
+		} else if(!it->members.empty() && lua_type(L, -1) == LUA_TTABLE) {
+			port_field_fromtable(L, *it, lua_gettop(L));
+		} else if((dsbp = luaM_testudata_mt(L, -1, "Variable", DataSourceBase::shared_ptr)) != NULL) {
+			if(dsbp->get() != it->dsb.get() && !it->dsb->update(dsbp->get()))
+				luaL_error(L, "OutputPort.write: failed to assign %s to member %s of type %s",
+					   (*dsbp)->getType().c_str(), it->name.c_str(), it->dsb->getType().c_str());
+		} else {
+			luaL_error(L, "OutputPort.write: can't convert lua %s to %s member %s",
+				   luaL_typename(L, -1), it->dsb->getTypeName().c_str(), it->name.c_str());
+		}
+		lua_pop(L, 1);
+	}
+}
+
 /* InputPort (boxed) */
 
 gen_push_bxptr(InputPort_push, "InputPort", InputPortInterface)
@@ -1342,19 +1762,31 @@ static int InputPort_new(lua_State *L)
 	return 1;
 }
 
+/* read(): returns the FlowStatus and the value, as a Lua value if it is
+ * basic and as a new Variable otherwise.
+ * read(Variable): reads into the given Variable.
+ * read(table): fills the table in place with the members of a struct,
+ * or leaves it untouched on NoData.
+ * The first and the last do not allocate for basic types and
+ * structs. */
 static int InputPort_read(lua_State *L)
 {
 	int ret = 1;
 	InputPortInterface *ip = *(luaM_checkudata_mt_bx(L, 1, "InputPort", InputPortInterface));
 	DataSourceBase::shared_ptr dsb;
 	DataSourceBase::shared_ptr *dsbp;
+	PortSample *ps = NULL;
 	FlowStatus fs;
 
-	/* if we get don't get a DS to store the result, create one */
+	/* if we get don't get a DS to store the result, use the sample */
 	if ((dsbp = luaM_testudata_mt(L, 2, "Variable", DataSourceBase::shared_ptr)) != NULL)
 		dsb = *dsbp;
 	else {
-		dsb = ip->getTypeInfo()->buildValue();
+		ps = port_sample(L, ip, 1);
+		if (ps->root.conv || lua_istable(L, 2))
+			dsb = ps->sample;
+		else
+			dsb = ip->getTypeInfo()->buildValue();
 		ret = 2;
 	}
 
@@ -1365,7 +1797,19 @@ static int InputPort_read(lua_State *L)
 	else if (fs == OldData) lua_pushstring(L, "OldData");
 	else luaL_error(L, "InputPort.read: unknown FlowStatus returned");
 
-	if(ret>1)
+	if(ret == 1)
+		return ret;
+
+	if(ps->root.conv)
+		ps->root.conv->tolua(L, dsb.get());
+	else if(lua_istable(L, 2)) {
+		if(ps->root.members.empty())
+			luaL_error(L, "InputPort.read: can't read %s into a table", dsb->getTypeName().c_str());
+		/* without data the sample holds nothing for the table */
+		if(fs != NoData)
+			port_field_totable(L, ps->root, 2);
+		lua_pushvalue(L, 2);
+	} else
 		Variable_push_coerce(L, dsb);
 
 	return ret;
@@ -1384,6 +1828,7 @@ static int InputPort_gc(lua_State *L)
 static int InputPort_del(lua_State *L)
 {
 	InputPortInterface *ip = *(luaM_checkudata_mt_bx(L, 1, "InputPort", InputPortInterface));
+	port_sample_clear(L, ip);
 	delete ip;
 
 	/* this prevents calling rtt methods which would cause a crash */
@@ -1444,10 +1889,13 @@ static int OutputPort_new(lua_State *L)
 	return 1;
 }
 
+/* write(Variable), write(basic Lua value) or write(table) for structs,
+ * the latter two are converted into the sample of the port. */
 static int OutputPort_write(lua_State *L)
 {
 	DataSourceBase::shared_ptr dsb;
 	DataSourceBase::shared_ptr *dsbp;
+	PortSample *ps;
 
 	OutputPortInterface *op = *(luaM_checkudata_mt_bx(L, 1, "OutputPort", OutputPortInterface));
 
@@ -1455,8 +1903,13 @@ static int OutputPort_write(lua_State *L)
 	if ((dsbp = luaM_testudata_mt(L, 2, "Variable", DataSourceBase::shared_ptr)) != NULL) {
 		dsb = *dsbp;
 	} else  {
-		/* slowpath: convert lua value to dsb */
-		dsb = Variable_fromlua(L, op->getTypeInfo(), 2);
+		/* convert lua value into the sample */
+		ps = port_sample(L, op, 1);
+		dsb = ps->sample;
+		if (!ps->root.conv && !ps->root.members.empty() && lua_istable(L, 2))
+			port_field_fromtable(L, ps->root, 2);
+		else
+			Variable_fromlua(L, dsb, 2);
 	}
 	op->write(dsb);
 	return 0;
@@ -1475,6 +1928,7 @@ static int OutputPort_gc(lua_State *L)
 static int OutputPort_del(lua_State *L)
 {
 	OutputPortInterface *op = *(luaM_checkudata_mt_bx(L, 1, "OutputPort", OutputPortInterface));
+	port_sample_clear(L, op);
 	delete op;
 
 	/* this prevents calling rtt methods which would cause a crash */
@@ -1520,6 +1974,8 @@ struct OperationHandle {
 	 */
 	std::vector<base::DataSourceBase::shared_ptr> dsb_store;
 	std::vector<internal::Reference*> args;
+	/* argument values reused by the batch calls */
+	std::vector<base::DataSourceBase::shared_ptr> batch_slots;
 	base::DataSourceBase::shared_ptr call_dsb;
 	base::DataSourceBase::shared_ptr ret_dsb;
 };
@@ -1632,6 +2088,129 @@ static int __Operation_send(lua_State *L)
 	return 1;
 }
 
+/* Create the batch_slots on first use. The slots stay referenced by
+ * the handle, so they outlive the calls. */
+static void __Operation_batch_prepare(lua_State *L, OperationHandle *oh, const char *what)
+{
+	if(!oh->batch_slots.empty())
+		return;
+
+	for(unsigned int arg=1; arg <= oh->arity; arg++) {
+		DataSourceBase::shared_ptr slot = oh->oip->getArgumentType(arg)->buildValue();
+		if(!slot)
+			luaL_error(L, "%s: failed to build value for arg %d", what, arg);
+		oh->batch_slots.push_back(slot);
+	}
+}
+
+/* Point argument arg (0 based) at the value at index ind. Like in
+ * Operation.call, a Variable is passed by reference, so reference
+ * arguments update it. Other values are converted into the slot. */
+static void __Operation_batch_arg(lua_State *L, OperationHandle *oh, int i, unsigned int arg, int ind, const char *what)
+{
+	DataSourceBase::shared_ptr dsb, *dsbp;
+
+	if ((dsbp = luaM_testudata_mt(L, ind, "Variable", DataSourceBase::shared_ptr)) != NULL) {
+		dsb = *dsbp;
+		if(!dsb->isAssignable())
+			luaL_error(L, "%s: call %d, argument %d is not assignable.", what, i, arg+1);
+	} else {
+		dsb = oh->batch_slots[arg];
+		Variable_fromlua(L, dsb, ind);
+	}
+
+	if(!oh->args[arg]->setReference(dsb))
+		luaL_error(L, "%s: call %d, wrong type of argument %d", what, i, arg+1);
+}
+
+/* set the arguments of tuple i (on top of the stack) */
+static void __Operation_batch_args(lua_State *L, OperationHandle *oh, int i, const char *what)
+{
+	int tupind = lua_gettop(L);
+
+	/* single argument operations accept plain values */
+	if(oh->arity == 1 && !lua_istable(L, tupind)) {
+		__Operation_batch_arg(L, oh, i, 0, tupind, what);
+		return;
+	}
+
+	if(!lua_istable(L, tupind))
+		luaL_error(L, "%s: call %d, expected table of arguments, got %s", what, i, luaL_typename(L, tupind));
+
+	if(lua_objlen(L, tupind) != oh->arity)
+		luaL_error(L, "%s: call %d, wrong number of args. expected %d, got %d",
+			   what, i, oh->arity, (int) lua_objlen(L, tupind));
+
+	/* the Variables stay referenced by the tuple during the call */
+	for(unsigned int arg=1; arg <= oh->arity; arg++) {
+		lua_rawgeti(L, tupind, arg);
+		__Operation_batch_arg(L, oh, i, arg-1, lua_gettop(L), what);
+		lua_pop(L, 1);
+	}
+}
+
+/* callBatch({ {args of call 1}, {args of call 2}, ... })
+ * returns a table with the results of all calls. Plain arguments are
+ * converted into the same values for every call, so the setup of
+ * the call is done once per batch instead of once per call. Variable
+ * arguments are passed by reference and receive out arguments. */
+static int __Operation_callBatch(lua_State *L)
+{
+	OperationHandle *oh = luaM_checkudata_mt(L, 1, "Operation", OperationHandle);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int n = lua_objlen(L, 2);
+	bool basic_ret;
+
+	__Operation_batch_prepare(L, oh, "Operation.callBatch");
+	basic_ret = !oh->is_void && __Variable_isbasic(L, oh->ret_dsb);
+
+	lua_createtable(L, n, 0);
+	for(int i=1; i<=n; i++) {
+		lua_rawgeti(L, 2, i);
+		__Operation_batch_args(L, oh, i, "Operation.callBatch");
+		lua_pop(L, 1);
+
+		if(!oh->occ->call())
+			luaL_error(L, "Operation.callBatch: call %d failed.", i);
+
+		if(oh->is_void)
+			continue;
+
+		if(basic_ret)
+			__Variable_tolua(L, oh->ret_dsb);
+		else {
+			/* the return value is reused, each result needs its own copy */
+			DataSourceBase::shared_ptr res = oh->ret_dsb->getTypeInfo()->buildValue();
+			res->update(oh->ret_dsb.get());
+			luaM_pushobject_mt(L, "Variable", DataSourceBase::shared_ptr)(res);
+		}
+		lua_rawseti(L, -2, i);
+	}
+	return 1;
+}
+
+/* sendBatch({ {args of send 1}, ... }) returns a table of SendHandles */
+static int __Operation_sendBatch(lua_State *L)
+{
+	OperationHandle *oh = luaM_checkudata_mt(L, 1, "Operation", OperationHandle);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	int n = lua_objlen(L, 2);
+
+	__Operation_batch_prepare(L, oh, "Operation.sendBatch");
+
+	lua_createtable(L, n, 0);
+	for(int i=1; i<=n; i++) {
+		lua_rawgeti(L, 2, i);
+		__Operation_batch_args(L, oh, i, "Operation.sendBatch");
+		lua_pop(L, 1);
+
+		/* send copies the arguments, so the slots can be reused */
+		luaM_pushobject_mt(L, "SendHandle", SendHandleC)(oh->occ->send());
+		lua_rawseti(L, -2, i);
+	}
+	return 1;
+}
+
 static int Operation_call(lua_State *L)
 {
 	int ret;
@@ -1659,10 +2238,38 @@ static int Operation_send(lua_State *L)
 }
 
 
+static int Operation_callBatch(lua_State *L)
+{
+	int ret;
+	try {
+		ret = __Operation_callBatch(L);
+	} catch(const std::exception &exc) {
+		luaL_error(L, "Operation.callBatch: caught exception '%s'", exc.what());
+	} catch(...) {
+		luaL_error(L, "Operation.callBatch: caught unknown exception");
+	}
+	return ret;
+}
+
+static int Operation_sendBatch(lua_State *L)
+{
+	int ret;
+	try {
+		ret = __Operation_sendBatch(L);
+	} catch(const std::exception &exc) {
+		luaL_error(L, "Operation.sendBatch: caught exception '%s'", exc.what());
+	} catch(...) {
+		luaL_error(L, "Operation.sendBatch: caught unknown exception");
+	}
+	return ret;
+}
+
 static const struct luaL_Reg Operation_f [] = {
 	{ "info", Operation_info },
 	{ "call", Operation_call },
 	{ "send", Operation_send },
+	{ "callBatch", Operation_callBatch },
+	{ "sendBatch", Operation_sendBatch },
 	{ NULL, NULL }
 
 };
@@ -1670,6 +2277,8 @@ static const struct luaL_Reg Operation_f [] = {
 static const struct luaL_Reg Operation_m [] = {
 	{ "info", Operation_info },
 	{ "send", Operation_send },
+	{ "callBatch", Operation_callBatch },
+	{ "sendBatch", Operation_sendBatch },
 	{ "__call", Operation_call },
 	{ "__gc", OperationGC<OperationHandle> },
 	{ NULL, NULL }
@@ -2317,6 +2926,9 @@ static int TaskContext_removePort(lua_State *L)
 {
 	TaskContext *tc = *(luaM_checkudata_bx(L, 1, TaskContext));
 	const char *port = luaL_checkstring(L, 2);
+	PortInterface *pi = tc->ports()->getPort(port);
+	if(pi)
+		port_sample_clear(L, pi);
 	tc->ports()->removePort(port);
 	return 0;
 }
@@ -3079,6 +3691,16 @@ int luaopen_rtt(lua_State *L)
 	luaL_register(L, NULL, OutputPort_m);
 	luaL_register(L, "rtt.OutputPort", OutputPort_f);
 
+	/* port samples are only used internally */
+	luaL_newmetatable(L, "PortSample");
+	lua_pushcfunction(L, GCMethod<PortSample>);
+	lua_setfield(L, -2, "__gc");
+
+	luaL_newmetatable(L, "VariablePath");
+	lua_pushvalue(L, -1); /* duplicates metatable */
+	lua_setfield(L, -2, "__index");
+	luaL_register(L, NULL, VariablePath_m);
+
 	luaL_newmetatable(L, "Variable");
 	lua_pushvalue(L, -1); /* duplicates metatable */
 	lua_setfield(L, -2, "__index");
@@ -3123,22 +3745,11 @@ int set_context_tc(TaskContext *tc, lua_State *L)
 }
 
 
-/* call a zero arity function with a boolean return value
- * used to call various hooks */
-bool call_func(lua_State *L, const char *fname, TaskContext *tc,
-	       int require_function, int require_result)
+/* call the function on top of the stack, see call_func */
+static bool __call_func_top(lua_State *L, const char *fname, TaskContext *tc, int require_result)
 {
 	bool ret = true;
 	int num_res = (require_result != 0) ? 1 : 0;
-	lua_getglobal(L, fname);
-
-	if(lua_isnil(L, -1)) {
-		lua_pop(L, 1);
-		if(require_function)
-			luaL_error(L, "%s: no (required) Lua function %s", tc->getName().c_str(), fname);
-		else
-			goto out;
-	}
 
 	if (lua_pcall(L, 0, num_res, 0) != 0) {
 		Logger::log(Logger::Error) << "LuaComponent '"<< tc->getName()  <<"': error calling function "
@@ -3163,3 +3774,48 @@ bool call_func(lua_State *L, const char *fname, TaskContext *tc,
  out:
 	return ret;
 }
+
+/* call a zero arity function with a boolean return value
+ * used to call various hooks */
+bool call_func(lua_State *L, const char *fname, TaskContext *tc,
+	       int require_function, int require_result)
+{
+	lua_getglobal(L, fname);
+
+	if(lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		if(require_function)
+			luaL_error(L, "%s: no (required) Lua function %s", tc->getName().c_str(), fname);
+		return true;
+	}
+
+	return __call_func_top(L, fname, tc, require_result);
+}
+
+/* release oldref and return a reference to the global function fname,
+ * or LUA_NOREF if there is no such function */
+int func_ref(lua_State *L, const char *fname, int oldref)
+{
+	luaL_unref(L, LUA_REGISTRYINDEX, oldref);
+	lua_getglobal(L, fname);
+
+	if(!lua_isfunction(L, -1)) {
+		lua_pop(L, 1);
+		return LUA_NOREF;
+	}
+	return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/* like call_func, but calls the function referenced by ref */
+bool call_func_ref(lua_State *L, int ref, const char *fname, TaskContext *tc,
+		   int require_function, int require_result)
+{
+	if(ref == LUA_NOREF || ref == LUA_REFNIL) {
+		if(require_function)
+			luaL_error(L, "%s: no (required) Lua function %s", tc->getName().c_str(), fname);
+		return true;
+	}
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+	return __call_func_top(L, fname, tc, require_result);
+}
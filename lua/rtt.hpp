@@ -32,6 +32,9 @@
  * Suite 330, Boston, MA  02111-1307  USA
  */
 
+#ifndef OCL_LUA_RTT_HPP
+#define OCL_LUA_RTT_HPP
+
 #include <rtt/TaskContext.hpp>
 #include <rtt/Port.hpp>
 #include <rtt/types/Types.hpp>
@@ -43,6 +46,9 @@
 #include <rtt/os/fosi.h>
 #include <rtt/internal/GlobalService.hpp>
 #include <rtt/types/GlobalsRepository.hpp>
+#include <string>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include <lua.h>
@@ -60,6 +66,49 @@ int set_context_tc(RTT::TaskContext*, lua_State*);
  * no boolean result is returned.
  */
 bool call_func(lua_State*, const char*, RTT::TaskContext*, int, int);
+
+/* resolve a global function into a registry reference once, and call
+ * it through that reference without looking up its name again. */
+int func_ref(lua_State*, const char*, int);
+bool call_func_ref(lua_State*, int, const char*, RTT::TaskContext*, int, int);
 }
 
 
+
+/*
+ * Converters between basic RTT types and Lua values.
+ *
+ * tolua pushes the value of ds on the stack, fromlua assigns the Lua
+ * value at valind to ds and returns false if that Lua value can't be
+ * converted. Both may raise a Lua error if ds can not be narrowed.
+ *
+ * The bindings know the standard RTT types. Typekits can register
+ * converters for their own types, which are then pushed to Lua as
+ * plain values instead of Variables. A converter registered for an
+ * already known type replaces it.
+ *
+ * The registry lives in the orocos-ocl-lua-common library, such that a
+ * converter reaches every Lua binding loaded in the process. Registered
+ * converters are never modified or freed, registering one again adds a
+ * new entry and increments the generation, which makes the bindings
+ * drop the converters they cached.
+ */
+typedef void (*Variable_tolua_fn)(lua_State *L, RTT::base::DataSourceBase *ds);
+typedef bool (*Variable_fromlua_fn)(lua_State *L, RTT::base::DataSourceBase *ds, int valind);
+
+struct VariableConv {
+	Variable_tolua_fn tolua;
+	Variable_fromlua_fn fromlua;
+};
+
+typedef std::vector<std::pair<std::string, const VariableConv*> > VariableConvList;
+
+void Variable_register_converter(const std::string& type, Variable_tolua_fn tolua, Variable_fromlua_fn fromlua);
+
+/* a copy of the registered converters, by type name */
+VariableConvList Variable_converters();
+
+/* incremented by each Variable_register_converter() */
+int Variable_converters_generation();
+
+#endif
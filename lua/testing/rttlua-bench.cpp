@@ -0,0 +1,276 @@
+/**
+ * @file rttlua-bench.cpp
+ * Microbenchmark of the Lua RTT bindings.
+ *
+ * Each benchmark is a snippet of Lua code run N times in a loop from
+ * within Lua. The time per iteration of an empty loop is subtracted.
+ * Allocations are counted by wrapping the lua_Alloc function of the
+ * state, so only allocations done through Lua are seen. Built as
+ * rttlua-bench and, with -DLUA_RTT_TLSF, as rttlua-tlsf-bench.
+ *
+ * usage: rttlua-bench [iterations] [filter]
+ */
+
+#include <rtt/os/main.h>
+#include <rtt/TaskContext.hpp>
+#include <rtt/Logger.hpp>
+#include <rtt/Property.hpp>
+#include <rtt/Operation.hpp>
+#include <rtt/Port.hpp>
+#include <rtt/Activity.hpp>
+#include <rtt/ConnPolicy.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <rtt/plugin/PluginLoader.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../rtt.hpp"
+
+#ifdef LUA_RTT_TLSF
+extern "C" {
+#include "../tlsf_rtt.h"
+}
+#endif
+
+using namespace std;
+using namespace RTT;
+
+namespace OCL
+{
+	/* provides the interface which is benchmarked */
+	class LuaBenchComp : public RTT::TaskContext
+	{
+	protected:
+		double dprop;
+		ConnPolicy sprop;
+		std::vector<double> vprop;
+
+		OutputPort<double> dout;
+		InputPort<double> din;
+		OutputPort<std::vector<double> > vout;
+		InputPort<std::vector<double> > vin;
+		OutputPort<ConnPolicy> sout;
+		InputPort<ConnPolicy> sin;
+
+		double op(double d) { return d*2; }
+
+	public:
+		LuaBenchComp(std::string name) : RTT::TaskContext(name),
+			dprop(1.0), vprop(16, 1.0),
+			dout("dout"), din("din"), vout("vout"), vin("vin"), sout("sout"), sin("sin")
+		{
+			this->addProperty("dprop", dprop).doc("double property");
+			this->addProperty("sprop", sprop).doc("struct property");
+			this->addProperty("vprop", vprop).doc("sequence property");
+
+			this->ports()->addPort(dout).doc("double output");
+			this->ports()->addPort(din).doc("double input");
+			this->ports()->addPort(vout).doc("sequence output");
+			this->ports()->addPort(vin).doc("sequence input");
+			this->ports()->addPort(sout).doc("struct output");
+			this->ports()->addPort(sin).doc("struct input");
+
+			vout.setDataSample(vprop);
+			dout.connectTo(&din);
+			vout.connectTo(&vin);
+			sout.connectTo(&sin);
+
+			this->addOperation("op_ct", &LuaBenchComp::op, this, ClientThread).doc("returns 2*d").arg("d", "any double");
+			this->addOperation("op_ot", &LuaBenchComp::op, this, OwnThread).doc("returns 2*d").arg("d", "any double");
+		}
+	};
+}
+
+/* counts the allocations done by a Lua state */
+struct alloc_count {
+	lua_Alloc f;
+	void *ud;
+	unsigned long allocs;
+};
+
+static void* count_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	struct alloc_count *ac = (struct alloc_count*) ud;
+	if(nsize > 0 && (ptr == NULL || nsize > osize))
+		ac->allocs++;
+	return ac->f(ac->ud, ptr, osize, nsize);
+}
+
+static void* plain_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	(void) ud; (void) osize;
+	if(nsize == 0) {
+		free(ptr);
+		return NULL;
+	}
+	return realloc(ptr, nsize);
+}
+
+struct bench {
+	const char *name;
+	const char *setup;	/* run once, may define locals used by body */
+	const char *body;	/* run once per iteration */
+};
+
+static const struct bench benches[] = {
+	{ "empty loop", "", "" },
+	{ "port write double", "local p=TC:getPort('dout')", "p:write(1.5)" },
+	{ "port read double", "local p=TC:getPort('din'); TC:getPort('dout'):write(1)", "local fs, v = p:read()" },
+	{ "port write struct", "local p=TC:getPort('sout'); local v=rtt.Variable.new('ConnPolicy')", "p:write(v)" },
+	{ "port read struct", "local p=TC:getPort('sin'); local v=rtt.Variable.new('ConnPolicy'); TC:getPort('sout'):write(v)", "p:read(v)" },
+	{ "port write sequence", "local p=TC:getPort('vout'); local v=rtt.Variable.new('array'); v:resize(16)", "p:write(v)" },
+	{ "port read sequence", "local p=TC:getPort('vin'); local v=rtt.Variable.new('array'); v:resize(16); TC:getPort('vout'):write(v)", "p:read(v)" },
+	{ "property get double", "local p=TC:getProperty('dprop')", "local v = p:get()" },
+	{ "property set double", "local p=TC:getProperty('dprop')", "p:set(2.5)" },
+	{ "property get struct", "local p=TC:getProperty('sprop')", "local v = p:get()" },
+	{ "property get sequence", "local p=TC:getProperty('vprop')", "local v = p:get()" },
+	{ "operation call", "local op=TC:getOperation('op_ct')", "local r = op(1.5)" },
+	{ "operation send+collect", "local op=TC:getOperation('op_ot')", "local ss, r = op:send(1.5):collect()" },
+	{ "member get struct", "local v=rtt.Variable.new('ConnPolicy')", "local s = v.size" },
+	{ "member set struct", "local v=rtt.Variable.new('ConnPolicy')", "v.size = 3" },
+	{ "member path get", "local p=rtt.Variable.new('ConnPolicy'):path('size')", "local s = p:get()" },
+	{ "member path set", "local p=rtt.Variable.new('ConnPolicy'):path('size')", "p:set(3)" },
+	{ "member get sequence", "local v=rtt.Variable.new('array'); v:resize(16)", "local s = v[7]" },
+	{ "member set sequence", "local v=rtt.Variable.new('array'); v:resize(16)", "v[7] = 1.5" },
+	{ "tolua double", "local v=rtt.Variable.new('double', 1.5)", "local x = v:tolua()" },
+	{ "tolua string", "local v=rtt.Variable.new('string', 'hello')", "local x = v:tolua()" },
+	{ "fromlua double", "local v=rtt.Variable.new('double')", "v:assign(1.5)" },
+	{ "fromlua string", "local v=rtt.Variable.new('string')", "v:assign('hello')" },
+	{ "Variable.new double", "", "local v=rtt.Variable.new('double', 1.5)" },
+	{ NULL, NULL, NULL }
+};
+
+/* load the benchmark and leave the loop function on the stack */
+static bool bench_load(lua_State *L, const struct bench *b)
+{
+	std::string chunk = std::string(b->setup) +
+		"\nreturn function(n) for i=1,n do " + b->body + " end end";
+
+	if(luaL_loadbuffer(L, chunk.c_str(), chunk.size(), b->name) || lua_pcall(L, 0, 1, 0)) {
+		fprintf(stderr, "%s: %s\n", b->name, lua_tostring(L, -1));
+		lua_pop(L, 1);
+		return false;
+	}
+	return true;
+}
+
+/* run the loop function on top of the stack n times, returns ns/op */
+static bool bench_run(lua_State *L, int n, struct alloc_count *ac, double *ns, double *allocs)
+{
+	os::TimeService::nsecs start;
+	unsigned long a0;
+
+	lua_pushvalue(L, -1);
+	lua_pushinteger(L, n);
+	a0 = ac->allocs;
+	start = os::TimeService::Instance()->getNSecs();
+
+	if(lua_pcall(L, 1, 0, 0)) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		lua_pop(L, 1);
+		return false;
+	}
+
+	*ns = (double) os::TimeService::Instance()->getNSecs(start) / n;
+	*allocs = (double) (ac->allocs - a0) / n;
+	return true;
+}
+
+int ORO_main(int argc, char** argv)
+{
+	int n = (argc > 1) ? atoi(argv[1]) : 100000;
+	const char *filter = (argc > 2) ? argv[2] : NULL;
+	double base = 0.0, ns, allocs;
+	struct alloc_count ac;
+	lua_State *L;
+
+	if(n <= 0) {
+		fprintf(stderr, "usage: %s [iterations] [filter]\n", argv[0]);
+		return 1;
+	}
+
+	plugin::PluginLoader::Instance()->loadTypekits("");
+
+	OCL::LuaBenchComp tc("bench");
+	tc.setActivity(new Activity(0, 0.0));
+	tc.start();
+
+#ifdef LUA_RTT_TLSF
+	struct lua_tlsf_info tlsf_inf;
+	if(tlsf_rtt_init_mp(&tlsf_inf, TLSF_INITIAL_POOLSIZE)) {
+		fprintf(stderr, "failed to create tlsf pool\n");
+		return 1;
+	}
+	ac.f = tlsf_alloc;
+	ac.ud = &tlsf_inf;
+#else
+	ac.f = plain_alloc;
+	ac.ud = NULL;
+#endif
+	ac.allocs = 0;
+
+	L = lua_newstate(count_alloc, &ac);
+	if(L == NULL) {
+		fprintf(stderr, "failed to allocate Lua state\n");
+		return 1;
+	}
+
+#ifdef LUA_RTT_TLSF
+	tlsf_inf.L = L;
+	set_context_tlsf_info(&tlsf_inf);
+	register_tlsf_api(L);
+#endif
+	luaL_openlibs(L);
+	lua_pushcfunction(L, luaopen_rtt);
+	lua_call(L, 0, 0);
+	set_context_tc(&tc, L);
+
+	/* like rttlua, but without loading rttlib */
+	if(luaL_dostring(L, "TC=rtt.getTC()")) {
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	printf("%-28s %12s %12s   (%d iterations%s)\n", "benchmark", "ns/op", "allocs/op", n,
+#ifdef LUA_RTT_TLSF
+	       ", TLSF"
+#else
+	       ""
+#endif
+		);
+
+	for(const struct bench *b = benches; b->name; b++) {
+		if(b != benches && filter && !strstr(b->name, filter))
+			continue;
+
+		if(!bench_load(L, b))
+			continue;
+
+		/* warm up caches, then collect garbage left by the setup */
+		if(!bench_run(L, (n < 1000) ? n : 1000, &ac, &ns, &allocs)) {
+			lua_pop(L, 1);
+			continue;
+		}
+		lua_gc(L, LUA_GCCOLLECT, 0);
+
+		if(bench_run(L, n, &ac, &ns, &allocs)) {
+			if(b == benches)
+				base = ns;
+			else
+				ns -= base;
+			printf("%-28s %12.1f %12.2f\n", b->name, ns, allocs);
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_close(L);
+#ifdef LUA_RTT_TLSF
+	tlsf_rtt_free_mp(&tlsf_inf);
+#endif
+	tc.stop();
+	return 0;
+}
@@ -145,6 +145,20 @@ function test_var_assignment()
    return true
 end
 
+function test_var_path()
+   local cp = var.new("ConnPolicy")
+   local sz = cp:path("size")
+   sz:set(17)
+   if sz:get() ~= 17 or cp.size ~= 17 then return false end
+
+   local a = var.new("array")
+   a:resize(2)
+   local e = a:path("1")
+   e:set(3.5)
+   a:resize(100)
+   return e:get() == 3.5 and a[1] == 3.5
+end
+
 function test_coercion()
    local x = testcomp:op_2("a-lua-string", 33.3)
    return x == 66.6
@@ -170,6 +184,23 @@ function test_send_op2_with_collect_args()
    else return true end
 end
 
+function test_call_batch_op2()
+   local res = testcomp:getOperation("op_2"):callBatch{ {"a", 1.5}, {"b", 2}, {"c", var.new("double", 3)} }
+   return #res == 3 and res[1] == 3 and res[2] == 4 and res[3] == 6
+end
+
+function test_call_batch_op_1_out()
+   local i, j = var.new("int", 1), var.new("int", 10)
+   testcomp:getOperation("op_1_out"):callBatch{ i, j, 5 }
+   return i:tolua() == 2 and j:tolua() == 11
+end
+
+function test_send_batch_op2()
+   local shs = testcomp:getOperation("op_2"):sendBatch{ {"a", 1}, {"b", 2} }
+   local ss1, res1 = shs[1]:collect()
+   local ss2, res2 = shs[2]:collect()
+   return ss1 == "SendSuccess" and res1 == 2 and ss2 == "SendSuccess" and res2 == 4
+end
 
 function test_dataflow_lua()
    po = rtt.OutputPort.new("string", "po", "my output port")
@@ -278,9 +309,13 @@ local tests = {
    { tfunc=test_call_op_1_out_retval, descr="post(testcomp:call('op_1_out_retval', 33)), i==34" },
    { tfunc=call_uint8_arg, descr="testing an operation call with an uint8 argument" },
    { tfunc=test_var_assignment, descr="testing assigment of variables" },
+   { tfunc=test_var_path, descr="testing member path accessors of variables" },
    { tfunc=test_coercion, descr="testing coercion of variables in call" },
    { tfunc=test_send_op2, descr="testing send for op_2 and collect()" },
    { tfunc=test_send_op2_with_collect_args, descr="testing sending op_2 and collect(var)"},
+   { tfunc=test_call_batch_op2, descr="testing callBatch for op_2" },
+   { tfunc=test_call_batch_op_1_out, descr="testing callBatch for op_1_out updates Variable arguments" },
+   { tfunc=test_send_batch_op2, descr="testing sendBatch for op_2 and collect()" },
    { tfunc=test_dataflow_lua, descr="testing dataflow with conversion from/to basic lua types" },
    { tfunc=test_lua_service, descr="testing interaction with lua service" },
    { tfunc=test_lua_eehook, descr="testing EEHook" },
@@ -0,0 +1,87 @@
+#!/usr/bin/env rttlua
+
+-- tests of OCL::LuaWorkerPool: run, submit and stopping with queued jobs
+
+require("rttlib")
+require("uunit")
+
+rtt.setLogLevel("Warning")
+var = rtt.Variable
+TC=rtt.getTC()
+d=TC:getPeer("Deployer")
+
+-- wait up to two seconds for cond() to become true
+function wait_for(cond)
+   for i=1,200 do
+      if cond() then return true end
+      rtt.sleep(0, 10000000)
+   end
+   return false
+end
+
+function counter(name) return pool:getAttribute(name):get() end
+
+function test_create_pool()
+   if not d:import("ocl") or not d:loadComponent("pool", "OCL::LuaWorkerPool") then
+      return false
+   end
+   pool = d:getPeer("pool")
+   pool:getProperty("workers"):set(1)
+   pool:getProperty("lua_string"):set([[
+      function echo(s) return s end
+      function slow(s)
+         local t = os.clock()
+         while os.clock() - t < 0.2 do end
+         return s
+      end
+   ]])
+   return pool:configure() and pool:start()
+end
+
+function test_run()
+   local res = var.new("string")
+   return pool:run("echo", "hello", res) and res:tolua() == "hello"
+end
+
+function test_run_error()
+   local res = var.new("string")
+   return not pool:run("no_such_function", "", res) and res:tolua() == "no Lua function no_such_function"
+end
+
+function test_submit()
+   local done = counter("jobs_done")
+   if pool:submit("echo", "hello") == 0 then return false end
+   return wait_for(function() return counter("jobs_done") == done + 1 end)
+end
+
+function test_stop_queued()
+   local done, failed = counter("jobs_done"), counter("jobs_failed")
+   for i=1,5 do
+      if pool:submit("slow", tostring(i)) == 0 then return false end
+   end
+   pool:stop()
+   -- every job either ran or was failed by stop, none is left behind
+   if pool:queued() ~= 0 or counter("jobs_done") + counter("jobs_failed") ~= done + failed + 5 then
+      print("jobs left behind:", pool:queued(), counter("jobs_done") - done, counter("jobs_failed") - failed)
+      return false
+   end
+   return counter("jobs_failed") > failed
+end
+
+function test_stopped()
+   local res = var.new("string")
+   return pool:submit("echo", "hello") == 0 and not pool:run("echo", "hello", res)
+      and res:tolua() == "LuaWorkerPool: not running"
+end
+
+tests = {
+   { tfunc=test_create_pool, descr="loading and starting a LuaWorkerPool with one worker" },
+   { tfunc=test_run, descr="run() returns the result of the job" },
+   { tfunc=test_run_error, descr="run() of an unknown function fails" },
+   { tfunc=test_submit, descr="submit() executes the job in the background" },
+   { tfunc=test_stop_queued, descr="stop() fails the queued jobs" },
+   { tfunc=test_stopped, descr="jobs are refused after stop()" },
+}
+
+uunit.run_tests(tests, true)
+uunit.print_stats(tests)
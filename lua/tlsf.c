@@ -616,6 +616,26 @@ size_t rtl_get_max_size(void *mem_pool ATTRIBUTE_UNUSED) {
 #endif
 }
 
+/******************************************************************/
+size_t rtl_get_largest_free(void *mem_pool) {
+/******************************************************************/
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    bhdr_t *b;
+    size_t max = 0;
+    int fl, sl;
+
+    if (!tlsf->fl_bitmap)
+        return 0;
+
+    /* the largest blocks are in the highest non empty list */
+    fl = ms_bit(tlsf->fl_bitmap);
+    sl = ms_bit(tlsf->sl_bitmap[fl]);
+    for (b = tlsf->matrix[fl][sl]; b; b = b->ptr.free_ptr.next)
+        if ((b->size & BLOCK_SIZE) > max)
+            max = b->size & BLOCK_SIZE;
+    return max;
+}
+
 /******************************************************************/
 void rtl_destroy_memory_pool(void *mem_pool) {
 /******************************************************************/
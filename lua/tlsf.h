@@ -24,6 +24,7 @@
 extern size_t rtl_init_memory_pool(size_t, void *);
 extern size_t rtl_get_used_size(void *);
 extern size_t rtl_get_max_size(void *);
+extern size_t rtl_get_largest_free(void *);
 extern void rtl_destroy_memory_pool(void *);
 extern size_t rtl_add_new_area(void *, size_t, void *);
 extern void *rtl_malloc_ex(size_t, void *);
@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "tlsf.h"
 #include "tlsf_rtt.h"
@@ -25,8 +26,9 @@ int tlsf_rtt_init_mp(struct lua_tlsf_info *tlsf_inf, size_t sz)
 {
 	tlsf_inf->L = NULL;
 	tlsf_inf->mask = 0;
-	tlsf_inf->pool2 = NULL;
+	tlsf_inf->n_areas = 0;
 	tlsf_inf->total_mem = 0;
+	tlsf_inf->alloc_failures = 0;
 
 	if(sz < TLSF_POOL_MIN_SIZE) {
 		fprintf(stderr, "error: requested tlsf pool size (0x%lx) too small\n", (unsigned long) sz);
@@ -49,11 +51,13 @@ int tlsf_rtt_init_mp(struct lua_tlsf_info *tlsf_inf, size_t sz)
 /* cleanup mempool */
 void tlsf_rtt_free_mp(struct lua_tlsf_info *tlsf_inf)
 {
+	 unsigned int i;
 	 rtl_destroy_memory_pool(tlsf_inf->pool);
 	 free(tlsf_inf->pool);
 
-	 if(tlsf_inf->pool2)
-		 free(tlsf_inf->pool2);
+	 for(i=0; i<tlsf_inf->n_areas; i++)
+		 free(tlsf_inf->areas[i]);
+	 tlsf_inf->n_areas = 0;
 }
 
 /* this hook will print a backtrace and reset itself */
@@ -81,23 +85,59 @@ void* tlsf_alloc (void *ud, void *ptr, size_t osize, size_t nsize)
 		}
 		_DBG(DEBUG_TLSF_ALLOC, tlsf_inf->mask, "allocating 0x%lx, osize=%lu, nsize=%lu",
 		     (unsigned long) ptr, (unsigned long) osize, (unsigned long) nsize);
-		return rtl_realloc_ex(ptr, nsize, tlsf_inf->pool);
+		ptr = rtl_realloc_ex(ptr, nsize, tlsf_inf->pool);
+		if(ptr == NULL)
+			tlsf_inf->alloc_failures++;
+		return ptr;
 	}
 }
 
+/* allocate and touch an area for tlsf_rtt_add_area. This may be
+ * called from any non real-time thread. */
+void* tlsf_rtt_area_alloc(size_t sz)
+{
+	void *area = malloc(sz);
+	if(area)
+		memset(area, 0, sz);
+	return area;
+}
+
+/* add an area allocated by tlsf_rtt_area_alloc to the pool, which
+ * then owns it. The caller must make sure the pool is not in use. */
+int tlsf_rtt_add_area(struct lua_tlsf_info *tlsf_inf, void *area, size_t sz)
+{
+	if(tlsf_inf->n_areas >= TLSF_MAX_AREAS)
+		return -1;
+
+	tlsf_inf->areas[tlsf_inf->n_areas++] = area;
+	tlsf_inf->total_mem += rtl_add_new_area(area, sz, tlsf_inf->pool);
+	return 0;
+}
+
 int tlsf_rtt_incmem(struct lua_tlsf_info *tlsf_inf, size_t sz)
 {
-	if(tlsf_inf->pool2 != NULL)
-		luaL_error(tlsf_inf->L, "tlsf_rtt_incmem: region already increased, (increasing cur. only possible once)");
+	void *area;
 
-	if((tlsf_inf->pool2 = malloc(sz)) == NULL)
-		luaL_error(tlsf_inf->L, "tlsf_rtt_incmem: failed to increase memory by %d bytes. Out of mem.");
+	if(tlsf_inf->n_areas >= TLSF_MAX_AREAS)
+		luaL_error(tlsf_inf->L, "tlsf_rtt_incmem: already increased %d times", TLSF_MAX_AREAS);
 
-	tlsf_inf->total_mem += rtl_add_new_area(tlsf_inf->pool2, sz, tlsf_inf->pool);
+	if((area = tlsf_rtt_area_alloc(sz)) == NULL)
+		luaL_error(tlsf_inf->L, "tlsf_rtt_incmem: failed to increase memory by %d bytes. Out of mem.", (int) sz);
 
+	tlsf_rtt_add_area(tlsf_inf, area, sz);
 	return 0;
 }
 
+void tlsf_rtt_get_stats(struct lua_tlsf_info *tlsf_inf, struct tlsf_rtt_stats *st)
+{
+	st->used = rtl_get_used_size(tlsf_inf->pool);
+	st->max_used = rtl_get_max_size(tlsf_inf->pool);
+	st->total = tlsf_inf->total_mem;
+	st->free = (st->total > st->used) ? st->total - st->used : 0;
+	st->largest_free = rtl_get_largest_free(tlsf_inf->pool);
+	st->alloc_failures = tlsf_inf->alloc_failures;
+}
+
 /* store and retrieve the tlsf_info in the registry
  * this is required for the enabling and disabling
  * trace functions
@@ -167,12 +207,15 @@ static int tlsf_warn(lua_State *L)
 
 static int tlsf_stats(lua_State *L)
 {
-	struct lua_tlsf_info *tlsf_inf = get_context_tlsf_info(L);
-
-	lua_pushinteger(L, rtl_get_used_size(tlsf_inf->pool));
-	lua_pushinteger(L, rtl_get_max_size(tlsf_inf->pool));
-	lua_pushinteger(L, tlsf_inf->total_mem);
-	return 3;
+	struct tlsf_rtt_stats st;
+	tlsf_rtt_get_stats(get_context_tlsf_info(L), &st);
+
+	lua_pushinteger(L, st.used);
+	lua_pushinteger(L, st.max_used);
+	lua_pushinteger(L, st.total);
+	lua_pushinteger(L, st.largest_free);
+	lua_pushinteger(L, st.alloc_failures);
+	return 5;
 }
 
 static const struct luaL_Reg tlsf_f [] = {
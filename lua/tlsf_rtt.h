@@ -4,21 +4,37 @@
 #include <lualib.h>
 
 #define TLSF_INITIAL_POOLSIZE	1*1024*1024
+#define TLSF_MAX_AREAS		16
 #undef	TLSF_DEBUG
 
 /* this is used as the opque Lua userdata to the alloc func */
 struct lua_tlsf_info {
 	void *pool;
-	void *pool2;
+	void *areas[TLSF_MAX_AREAS];	/* areas added to the pool */
+	unsigned int n_areas;
 	unsigned int total_mem;
 	unsigned int mask;
+	unsigned int alloc_failures;
 	lua_State *L;
 };
 
+/* snapshot of the pool usage, in bytes */
+struct tlsf_rtt_stats {
+	unsigned int used;
+	unsigned int free;
+	unsigned int max_used;
+	unsigned int largest_free;
+	unsigned int total;
+	unsigned int alloc_failures;
+};
+
 int tlsf_rtt_init_mp(struct lua_tlsf_info *tlsf_inf, size_t sz);
 void tlsf_rtt_free_mp(struct lua_tlsf_info *tlsf_inf);
 void* tlsf_alloc (void *ud, void *ptr, size_t osize, size_t nsize);
 int tlsf_rtt_incmem(struct lua_tlsf_info *tlsf_inf, size_t sz);
+void* tlsf_rtt_area_alloc(size_t sz);
+int tlsf_rtt_add_area(struct lua_tlsf_info *tlsf_inf, void *area, size_t sz);
+void tlsf_rtt_get_stats(struct lua_tlsf_info *tlsf_inf, struct tlsf_rtt_stats *st);
 void set_context_tlsf_info(struct lua_tlsf_info*);
 void register_tlsf_api(lua_State *L);
 
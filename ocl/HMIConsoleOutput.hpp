@@ -31,11 +31,11 @@
 #include <rtt/TaskContext.hpp>
 #include <rtt/Activity.hpp>
 #include <rtt/Logger.hpp>
-#include <rtt/os/MutexLock.hpp>
 #include <sstream>
 #include <iostream>
 
 #include <ocl/OCL.hpp>
+#include <ocl/TextQueue.hpp>
 
 namespace OCL
 {
@@ -45,27 +45,86 @@ namespace OCL
      *
      * It is known as the 'cout' component in scripts.
      *
+     * The display* and log* operations copy their argument into a
+     * fixed size record of a preallocated lock-free queue and trigger
+     * the component. They do not lock, allocate or format, so they may
+     * be called from real-time components. All formatting is done in
+     * updateHook(). When the queue is full, messages are dropped and
+     * counted in the 'dropped' attribute. Strings longer than
+     * MaxText characters are truncated.
+     *
      * HMI == Human-Machine Interface
      */
     class OCL_API HMIConsoleOutput
         : public RTT::TaskContext
     {
+    public:
+        enum { MaxText = 240, QueueSize = 256 };
+
+    private:
+        /**
+         * The kind and value of a queued display or log message.
+         */
+        struct Message {
+            enum Type { String, Bool, Int, Double };
+            bool log;
+            unsigned char type;
+            union {
+                bool b;
+                int i;
+                double d;
+            } value;
+        };
+        typedef TextQueue<Message, MaxText, QueueSize> Queue;
+
         std::string coloron;
         std::string coloroff;
         std::string _prompt;
+        Queue queue;
+        unsigned int dropped;
         std::ostringstream messages;
-        std::ostringstream backup;
         std::ostringstream logmessages;
-        std::ostringstream logbackup;
 
-        RTT::os::Mutex msg_lock;
-        RTT::os::Mutex log_lock;
+        void push(const Message& m, const char* what = 0, std::size_t len = 0)
+        {
+            queue.push( m, what, len );
+            // support for non periodic logging:
+            if ( this->engine()->getActivity() )
+                this->engine()->getActivity()->trigger();
+        }
+
+        void push(bool log, const char* what, std::size_t len)
+        {
+            Message m;
+            m.log = log;
+            m.type = Message::String;
+            push( m, what, len );
+        }
+
+        void format(std::ostream& os, const Queue::Record& r)
+        {
+            switch ( r.header.type ) {
+            case Message::String:
+                Queue::write( os, r );
+                break;
+            case Message::Bool:
+                os << r.header.value.b;
+                break;
+            case Message::Int:
+                os << r.header.value.i;
+                break;
+            case Message::Double:
+                os << r.header.value.d;
+                break;
+            }
+        }
 
     public :
         HMIConsoleOutput( const std::string& name = "cout")
             : RTT::TaskContext( name ),
               coloron("\033[1;34m"), coloroff("\033[0m"),
-              _prompt("HMIConsoleOutput :\n")
+              _prompt("HMIConsoleOutput :\n"),
+              dropped(0)
         {
             this->addOperation("display", &HMIConsoleOutput::display, this, RTT::ClientThread).doc("Display a message on the console").arg("message", "The message to be displayed");
             this->addOperation("displayBool", &HMIConsoleOutput::displayBool, this, RTT::ClientThread).doc("Display a boolean on the console").arg("boolean", "The Boolean to be displayed");
@@ -75,7 +134,7 @@ namespace OCL
             this->addOperation("logBool", &HMIConsoleOutput::logBool, this, RTT::ClientThread).doc("Log a boolean on the console").arg("boolean", "The Boolean to be logged");
             this->addOperation("logInt", &HMIConsoleOutput::logInt, this, RTT::ClientThread).doc("Log a integer on the console").arg("integer", "The Integer to be logged");
             this->addOperation("logDouble", &HMIConsoleOutput::logDouble, this, RTT::ClientThread).doc("Log a double on the console").arg("double", "The Double to be logged");
-
+            this->addAttribute("dropped", dropped);
         }
 
         ~HMIConsoleOutput()
@@ -85,20 +144,28 @@ namespace OCL
 
         void updateHook()
         {
-            {
-                RTT::os::MutexLock lock1( msg_lock );
-                if ( ! messages.str().empty() ) {
-                    std::cout << coloron << _prompt<< coloroff <<
-                        messages.str() << std::endl;
-                    messages.rdbuf()->str("");
+            Queue::Record r;
+            while ( queue.pop( r ) ) {
+                if ( r.header.log ) {
+                    format( logmessages, r );
+                } else {
+                    format( messages, r );
+                    messages << std::endl;
                 }
             }
-            {
-                RTT::os::MutexLock lock1( log_lock );
-                if ( ! logmessages.str().empty() ) {
-                    RTT::log(RTT::Info) << logmessages.str() << RTT::endlog();
-                    logmessages.rdbuf()->str("");
-                }
+
+            dropped = queue.dropped();
+            if ( unsigned int n = queue.newlyDropped() )
+                messages << "(" << n << " messages dropped)" << std::endl;
+
+            if ( ! messages.str().empty() ) {
+                std::cout << coloron << _prompt<< coloroff <<
+                    messages.str() << std::endl;
+                messages.str("");
+            }
+            if ( ! logmessages.str().empty() ) {
+                RTT::log(RTT::Info) << logmessages.str() << RTT::endlog();
+                logmessages.str("");
             }
         }
 
@@ -130,31 +197,21 @@ namespace OCL
          */
         void display(const std::string & what)
         {
-            this->enqueue( what );
+            this->push( false, what.c_str(), what.size() );
         }
 
         /**
          * Put a message in the queue.
          * The message must be convertible to a stream using
-         * operator<<().
+         * operator<<(). Unlike the display* functions, this formats
+         * the message in the calling thread.
          */
         template<class T>
         void enqueue( const T& what )
         {
-            {
-                RTT::os::MutexTryLock try_lock( msg_lock );
-                if ( try_lock.isSuccessful() ) {
-                    // we got the lock, copy everything...
-                    messages << backup.str();
-                    messages << what << std::endl;
-                    backup.rdbuf()->str("");
-                }
-                else  // no lock, backup.
-                    backup << what << std::endl;
-                // support for non periodic logging:
-            }
-            if ( this->engine()->getActivity() )
-                this->engine()->getActivity()->trigger();
+            std::ostringstream os;
+            os << what;
+            this->display( os.str() );
         }
 
         /**
@@ -162,7 +219,11 @@ namespace OCL
          */
         void displayBool(bool what)
         {
-            this->enqueue( what );
+            Message m;
+            m.log = false;
+            m.type = Message::Bool;
+            m.value.b = what;
+            this->push( m );
         }
 
         /**
@@ -170,7 +231,11 @@ namespace OCL
          */
         void displayInt( int what)
         {
-            this->enqueue( what );
+            Message m;
+            m.log = false;
+            m.type = Message::Int;
+            m.value.i = what;
+            this->push( m );
         }
 
         /**
@@ -178,38 +243,39 @@ namespace OCL
          */
         void displayDouble( double what )
         {
-            this->enqueue( what );
+            Message m;
+            m.log = false;
+            m.type = Message::Double;
+            m.value.d = what;
+            this->push( m );
         }
 
+        /**
+         * Put a log message in the queue, formatted in the calling
+         * thread with operator<<().
+         */
         template<class T>
         void dolog( const T& what )
         {
-            {
-                RTT::os::MutexTryLock try_lock( log_lock );
-                if ( try_lock.isSuccessful() ) {
-                    // we got the lock, copy everything...
-                    logmessages << logbackup.str();
-                    logmessages << what;
-                    logbackup.rdbuf()->str("");
-                }
-                else  // no lock, backup.
-                    logbackup << what;
-            }
-            if ( this->engine()->getActivity() )
-                this->engine()->getActivity()->trigger();
+            std::ostringstream os;
+            os << what;
+            this->log( os.str() );
         }
 
-
         void log(const std::string & what)
         {
-            this->dolog( what );
+            this->push( true, what.c_str(), what.size() );
         }
         /**
          * @brief Log a boolean on standard output.
          */
         void logBool(bool what)
         {
-            this->dolog( what );
+            Message m;
+            m.log = true;
+            m.type = Message::Bool;
+            m.value.b = what;
+            this->push( m );
         }
 
         /**
@@ -217,7 +283,11 @@ namespace OCL
          */
         void logInt( int what)
         {
-            this->dolog( what );
+            Message m;
+            m.log = true;
+            m.type = Message::Int;
+            m.value.i = what;
+            this->push( m );
         }
 
         /**
@@ -225,7 +295,11 @@ namespace OCL
          */
         void logDouble( double what )
         {
-            this->dolog( what );
+            Message m;
+            m.log = true;
+            m.type = Message::Double;
+            m.value.d = what;
+            this->push( m );
         }
 
     };
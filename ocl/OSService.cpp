@@ -1,10 +1,18 @@
 #include <rtt/os/fosi.h>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
 #include <rtt/Service.hpp>
+#include <rtt/Property.hpp>
+#include <rtt/PropertyBag.hpp>
+#include <rtt/Logger.hpp>
 #include <rtt/plugin/ServicePlugin.hpp>
 #include <cstdlib>
+#include <vector>
 
 #ifndef WIN32
 #include <sys/wait.h>
+#include <time.h>
 #endif
 
 // setEnvString and isEnv needed to be implemented because we
@@ -55,6 +63,54 @@ bool isEnv(const char* name)
 }
 #endif
 
+// Monotonic and cpu time clocks, in nanoseconds.
+#ifdef WIN32
+long long monotonicNSecs()
+{
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (long long)(count.QuadPart / freq.QuadPart) * 1000000000LL
+        + (long long)(count.QuadPart % freq.QuadPart) * 1000000000LL / freq.QuadPart;
+}
+
+long long fileTimeNSecs(const FILETIME& kernel, const FILETIME& user)
+{
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (long long)(k.QuadPart + u.QuadPart) * 100; // 100ns units
+}
+
+long long threadCpuNSecs()
+{
+    FILETIME c, e, k, u;
+    if ( !GetThreadTimes(GetCurrentThread(), &c, &e, &k, &u) )
+        return 0;
+    return fileTimeNSecs(k, u);
+}
+
+long long processCpuNSecs()
+{
+    FILETIME c, e, k, u;
+    if ( !GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u) )
+        return 0;
+    return fileTimeNSecs(k, u);
+}
+#else
+long long clockNSecs(clockid_t clock)
+{
+    timespec ts;
+    if ( clock_gettime(clock, &ts) != 0 )
+        return 0;
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long monotonicNSecs() { return clockNSecs(CLOCK_MONOTONIC); }
+long long threadCpuNSecs() { return clockNSecs(CLOCK_THREAD_CPUTIME_ID); }
+long long processCpuNSecs() { return clockNSecs(CLOCK_PROCESS_CPUTIME_ID); }
+#endif
+
 #include <rtt/os/startstop.h>
 
 namespace OCL
@@ -66,9 +122,32 @@ namespace OCL
      */
     class OSService: public RTT::Service
     {
+        /**
+         * A named section of code which is timed with startRegion()
+         * and stopRegion(). Its statistics are in a PropertyBag of
+         * the Regions property of the service.
+         */
+        struct Region {
+            long long start;
+            unsigned int count;
+            double last, min, max, mean, total;
+            double bin_width;
+            std::vector<double> histogram;
+            RTT::PropertyBag bag;
+        };
+
+        // regions are only added up to max_regions, such that the vector is
+        // never reallocated while other threads start and stop regions.
+        static const unsigned int max_regions = 64;
+        std::vector<Region*> regions;
+        RTT::os::AtomicInt nregions;
+        RTT::os::Mutex regions_lock;
+        RTT::PropertyBag regions_bag;
+        long long epoch;
+
     public:
         OSService(RTT::TaskContext* parent) :
-            RTT::Service("os", parent)
+            RTT::Service("os", parent), nregions(0), epoch(monotonicNSecs())
         {
             doc("A service that provides access to some useful Operating System functions.");
             // add the operations
@@ -93,6 +172,129 @@ namespace OCL
                     .arg("seconds", "Sleep for x seconds")
                     .arg("nanoseconds", "Sleep for x nanoseconds");
             addOperation("execute", &OSService::execute, this).doc("Execute a shell command");
+
+            addOperation("monotonic", &OSService::monotonic, this, RTT::ClientThread).doc(
+                    "Returns the time of a monotonic clock, in seconds. Unlike the system time, it never jumps.");
+            addOperation("nanoseconds", &OSService::nanoseconds, this, RTT::ClientThread).doc(
+                    "Returns the time of the monotonic clock in nanoseconds, since this service was loaded, "
+                    "such that it is exact in a double for more than 100 days.");
+            addOperation("threadCpuTime", &OSService::threadCpuTime, this, RTT::ClientThread).doc(
+                    "Returns the cpu time used by the calling thread, in seconds.");
+            addOperation("processCpuTime", &OSService::processCpuTime, this, RTT::ClientThread).doc(
+                    "Returns the cpu time used by all threads of this process, in seconds.");
+
+            regions.reserve(max_regions);
+            addProperty("Regions", regions_bag).doc("The statistics of each profiling region, see addRegion().");
+            addOperation("addRegion", &OSService::addRegion, this).doc(
+                    "Adds a profiling region and returns its id, or the id of the region with that name if it exists. "
+                    "Returns -1 if no more regions can be added.")
+                    .arg("name", "The name of the region in the Regions property.")
+                    .arg("bins", "The number of histogram bins, the last bin counts all longer sections.")
+                    .arg("binWidth", "The width of a histogram bin, in seconds.");
+            addOperation("startRegion", &OSService::startRegion, this, RTT::ClientThread).doc(
+                    "Marks the start of a region. A region must be started and stopped by one thread at a time.")
+                    .arg("id", "The id returned by addRegion().");
+            addOperation("stopRegion", &OSService::stopRegion, this, RTT::ClientThread).doc(
+                    "Marks the end of a region, adds its duration to the statistics and returns it, in seconds.")
+                    .arg("id", "The id returned by addRegion().");
+            addOperation("resetRegion", &OSService::resetRegion, this, RTT::ClientThread).doc(
+                    "Clears the statistics of a region.")
+                    .arg("id", "The id returned by addRegion().");
+        }
+
+        ~OSService()
+        {
+            for (unsigned int i = 0; i != regions.size(); ++i)
+                delete regions[i];
+        }
+
+        double monotonic()
+        {
+            return monotonicNSecs() * 1e-9;
+        }
+
+        double nanoseconds()
+        {
+            return double( monotonicNSecs() - epoch );
+        }
+
+        double threadCpuTime()
+        {
+            return threadCpuNSecs() * 1e-9;
+        }
+
+        double processCpuTime()
+        {
+            return processCpuNSecs() * 1e-9;
+        }
+
+        int addRegion(const std::string& name, unsigned int bins, double binWidth)
+        {
+            RTT::os::MutexLock lock(regions_lock);
+            for (unsigned int i = 0; i != regions.size(); ++i)
+                if ( regions[i]->bag.getType() == name )
+                    return i;
+            if ( regions.size() == max_regions ) {
+                RTT::log(RTT::Error) << "OSService: can not add region " << name << ", there are already "
+                                     << max_regions << " regions." << RTT::endlog();
+                return -1;
+            }
+            Region* r = new Region();
+            r->bin_width = binWidth;
+            r->histogram.resize( bins ? bins : 1 );
+            clearRegion(r);
+            r->bag.setType( name );
+            r->bag.addProperty("Count", r->count).doc("Number of times the region was stopped.");
+            r->bag.addProperty("Last", r->last).doc("Last duration, in seconds.");
+            r->bag.addProperty("Min", r->min).doc("Shortest duration, in seconds.");
+            r->bag.addProperty("Max", r->max).doc("Longest duration, in seconds.");
+            r->bag.addProperty("Mean", r->mean).doc("Mean duration, in seconds.");
+            r->bag.addProperty("Total", r->total).doc("Sum of all durations, in seconds.");
+            r->bag.addProperty("HistogramBinWidth", r->bin_width).doc("Width of a histogram bin, in seconds.");
+            r->bag.addProperty("Histogram", r->histogram).doc("Number of durations per bin. The last bin counts all longer ones.");
+            regions_bag.addProperty(name, r->bag).doc("Statistics of region " + name + ".");
+            regions.push_back(r);
+            nregions.set( regions.size() );
+            return regions.size() - 1;
+        }
+
+        void startRegion(int id)
+        {
+            if ( id < 0 || id >= nregions.read() )
+                return;
+            regions[id]->start = monotonicNSecs();
+        }
+
+        double stopRegion(int id)
+        {
+            long long now = monotonicNSecs();
+            if ( id < 0 || id >= nregions.read() )
+                return 0.0;
+            Region* r = regions[id];
+            if ( r->start == 0 )
+                return 0.0;
+            double d = (now - r->start) * 1e-9;
+            r->start = 0;
+            r->last = d;
+            r->total += d;
+            ++r->count;
+            if ( r->count == 1 || d < r->min )
+                r->min = d;
+            if ( d > r->max )
+                r->max = d;
+            r->mean = r->total / r->count;
+            unsigned int bin = r->bin_width > 0.0 ? (unsigned int)(d / r->bin_width) : 0;
+            if ( bin >= r->histogram.size() )
+                bin = r->histogram.size() - 1;
+            r->histogram[bin] += 1.0;
+            return d;
+        }
+
+        void resetRegion(int id)
+        {
+            if ( id < 0 || id >= nregions.read() )
+                return;
+            clearRegion( regions[id] );
         }
 
         int argc(void)
@@ -174,6 +376,15 @@ namespace OCL
             }
 #endif
         }
+
+    private:
+        void clearRegion(Region* r)
+        {
+            r->start = 0;
+            r->count = 0;
+            r->last = r->min = r->max = r->mean = r->total = 0.0;
+            r->histogram.assign( r->histogram.size(), 0.0 );
+        }
     };
 }
 
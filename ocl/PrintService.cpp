@@ -1,5 +1,10 @@
 #include <rtt/Service.hpp>
 #include <rtt/Logger.hpp>
+#include <rtt/Activity.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
 #include <iostream>
 
 #include <rtt/types/GlobalsRepository.hpp>
@@ -7,6 +12,9 @@
 #include <rtt/types/TypeInfoName.hpp>
 #include <rtt/plugin/ServicePlugin.hpp>
 #include "OCL.hpp"
+#include "TextQueue.hpp"
+#include <boost/lexical_cast.hpp>
+#include <sstream>
 
 namespace OCL
 {
@@ -14,12 +22,102 @@ namespace OCL
     /**
      * A service that provides basic printing to std::cout, std::cerr and the RTT::Logger.
      * Can be loaded in scripts by writing 'requires("print")' on top of the file.
+     *
+     * By default, the lines are written in the calling thread. After
+     * buffered(true), they are copied into a fixed size record of a
+     * preallocated lock-free queue instead, such that printing does not
+     * block a real-time component on a slow terminal or pipe. A low
+     * priority thread writes all queued lines to each stream at once.
+     * When the queue is full, lines are dropped and counted in the
+     * 'dropped' attribute. Lines longer than MaxText characters are
+     * truncated. The queue is flushed when the service is destroyed.
      */
     class PrintService: public RTT::Service
     {
+    public:
+        enum { MaxText = 240, QueueSize = 256 };
+
+    private:
+        /**
+         * Where a queued line goes.
+         */
+        struct Line {
+            enum Stream { Out, Err, Log };
+            unsigned char stream;
+            unsigned char level;
+        };
+        typedef TextQueue<Line, MaxText, QueueSize> Queue;
+
+        /**
+         * Writes the queued lines when triggered.
+         */
+        class Writer: public base::RunnableInterface
+        {
+            PrintService* ps;
+        public:
+            Writer(PrintService* p) : ps(p) {}
+            bool initialize() { return true; }
+            void step() { ps->drain(); }
+            bool breakLoop() { return true; }
+            void finalize() {}
+        };
+        friend class Writer;
+
+        Queue queue;
+        unsigned int dropped;
+        os::Mutex drain_lock;
+        std::string out, err;
+        Writer writer;
+        base::ActivityInterface* mact;
+        os::AtomicInt mbuffered;
+
+        void push(Line::Stream stream, Logger::LogLevel level, const std::string& arg)
+        {
+            Line l;
+            l.stream = stream;
+            l.level = level;
+            queue.push( l, arg.c_str(), arg.size() );
+            mact->trigger();
+        }
+
+        /* writes all queued lines, in the writer thread or in flush() */
+        void drain()
+        {
+            os::MutexLock lock(drain_lock);
+            Queue::Record r;
+            while ( queue.pop( r ) ) {
+                if ( r.header.stream == Line::Log ) {
+                    std::string line;
+                    Queue::append( line, r );
+                    log(LoggerLevel(r.header.level)) << line << endlog();
+                    continue;
+                }
+                std::string& s = r.header.stream == Line::Out ? out : err;
+                Queue::append( s, r );
+                s += '\n';
+            }
+            dropped = queue.dropped();
+            if ( unsigned int n = queue.newlyDropped() ) {
+                std::stringstream ss;
+                ss << "(" << n << " lines dropped)\n";
+                err += ss.str();
+            }
+            if ( !out.empty() ) {
+                std::cout.write( out.data(), out.size() );
+                std::cout.flush();
+                out.clear();
+            }
+            if ( !err.empty() ) {
+                std::cerr.write( err.data(), err.size() );
+                err.clear();
+            }
+        }
+
     public:
         PrintService(TaskContext* parent) :
-            RTT::Service("print", parent)
+            RTT::Service("print", parent),
+            dropped(0),
+            writer(this), mact(0), mbuffered(0)
         {
             doc("A service that provides basic printing to std::cout, std::cerr and the RTT::Logger.");
             // add the operations
@@ -32,6 +130,13 @@ namespace OCL
             addOperation("log", &PrintService::printlog, this).doc(
                     "Prints a line to Orocos logger class.").arg("level","The LogLevel to use.").arg("line",
                     "A string. Use a '+' to mix strings with numbers/variables.");
+            addOperation("buffered", &PrintService::buffered, this).doc(
+                    "Queue the lines and write them in a background thread, such that printing never blocks. "
+                    "Lines longer than " + boost::lexical_cast<std::string>((int)MaxText) + " characters are truncated.")
+                    .arg("enable", "True to queue, false to write in the calling thread again.");
+            addOperation("flush", &PrintService::flush, this, RTT::ClientThread).doc(
+                    "Writes all queued lines now.");
+            addAttribute("dropped", dropped);
 
             // add the log-levels as global variables.
             if (types::Types()->type("LogLevel") == 0) {
@@ -51,16 +156,62 @@ namespace OCL
             }
         }
 
+        ~PrintService()
+        {
+            buffered(false);
+            delete mact;
+        }
+
+        bool buffered(bool enable)
+        {
+            if ( enable ) {
+                // the activity is kept until destruction, a printing thread may still trigger it.
+                if ( !mact ) {
+                    mact = new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.0, &writer, "PrintService");
+                    // room for a full queue, so that draining does not allocate
+                    out.reserve( QueueSize * (MaxText + 4) );
+                    err.reserve( QueueSize * (MaxText + 4) );
+                }
+                if ( !mact->isActive() && !mact->start() )
+                    return false;
+                mbuffered.set(1);
+                return true;
+            }
+            mbuffered.set(0);
+            if ( mact )
+                mact->stop();
+            // lines queued while stopping.
+            drain();
+            return true;
+        }
+
+        void flush()
+        {
+            drain();
+        }
+
         void println(const std::string& arg)
         {
+            if ( mbuffered.read() ) {
+                push( Line::Out, Logger::Info, arg );
+                return;
+            }
             std::cout << arg << std::endl;
         }
         void printerr(const std::string& arg)
         {
+            if ( mbuffered.read() ) {
+                push( Line::Err, Logger::Info, arg );
+                return;
+            }
             std::cerr << arg << std::endl;
         }
         void printlog(Logger::LogLevel level, const std::string& arg)
         {
+            if ( mbuffered.read() ) {
+                push( Line::Log, level, arg );
+                return;
+            }
             log(LoggerLevel(level)) << arg <<endlog();
         }
     };
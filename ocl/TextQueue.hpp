@@ -0,0 +1,128 @@
+/***************************************************************************
+                        TextQueue.hpp -  description
+                           -------------------
+    begin                : October 2026
+
+ ***************************************************************************
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Lesser General Public            *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2.1 of the License, or (at your option) any later version.    *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place,                                    *
+ *   Suite 330, Boston, MA  02111-1307  USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef OCL_TEXT_QUEUE_HPP
+#define OCL_TEXT_QUEUE_HPP
+
+#include <rtt/base/BufferLockFree.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <ostream>
+#include <string>
+#include <cstring>
+
+namespace OCL
+{
+    /**
+     * A preallocated lock-free queue of fixed size text records, for
+     * handing text from real-time threads to a thread which writes it.
+     *
+     * push() copies the text into a record without locking or
+     * allocating. Text longer than MaxText characters is truncated.
+     * When the queue is full, the record is dropped and counted.
+     * Each record carries a user defined Header, which must be a POD.
+     */
+    template<class Header, unsigned int MaxTextSize = 240, unsigned int Size = 256>
+    class TextQueue
+    {
+    public:
+        enum { MaxText = MaxTextSize, QueueSize = Size };
+
+        struct Record {
+            Header header;
+            bool truncated;
+            unsigned short len;
+            char text[MaxText];
+        };
+
+        TextQueue()
+            : queue( QueueSize ), drops(0), reported(0)
+        {}
+
+        /**
+         * Queues \a header with \a len characters of \a text.
+         * @return false if the record was dropped.
+         */
+        bool push(const Header& header, const char* text = 0, std::size_t len = 0)
+        {
+            Record r;
+            r.header = header;
+            r.truncated = len > MaxText;
+            r.len = r.truncated ? MaxText : len;
+            if ( r.len )
+                std::memcpy( r.text, text, r.len );
+            if ( queue.Push( r ) )
+                return true;
+            drops.inc();
+            return false;
+        }
+
+        bool pop(Record& r)
+        {
+            return queue.Pop( r );
+        }
+
+        /**
+         * Total number of dropped records.
+         */
+        unsigned int dropped() const
+        {
+            return drops.read();
+        }
+
+        /**
+         * Number of records dropped since the previous call. Only to
+         * be called by the thread which pops the records.
+         */
+        unsigned int newlyDropped()
+        {
+            unsigned int d = drops.read();
+            unsigned int n = d - reported;
+            reported = d;
+            return n;
+        }
+
+        /**
+         * Writes the text of \a r, with "..." if it was truncated.
+         */
+        static void write(std::ostream& os, const Record& r)
+        {
+            os.write( r.text, r.len );
+            if ( r.truncated )
+                os << "...";
+        }
+
+        static void append(std::string& s, const Record& r)
+        {
+            s.append( r.text, r.len );
+            if ( r.truncated )
+                s += "...";
+        }
+
+    private:
+        RTT::base::BufferLockFree<Record> queue;
+        RTT::os::AtomicInt drops;
+        unsigned int reported;
+    };
+}
+
+#endif
@@ -0,0 +1,234 @@
+/***************************************************************************
+                        TimingService.cpp -  description
+                           -------------------
+    begin                : October 2026
+
+ ***************************************************************************
+ *   This library is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU Lesser General Public            *
+ *   License as published by the Free Software Foundation; either          *
+ *   version 2.1 of the License, or (at your option) any later version.    *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place,                                    *
+ *   Suite 330, Boston, MA  02111-1307  USA                                *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <rtt/Service.hpp>
+#include <rtt/TaskContext.hpp>
+#include <rtt/ExecutionEngine.hpp>
+#include <rtt/OutputPort.hpp>
+#include <rtt/base/ExecutableInterface.hpp>
+#include <rtt/base/TaskCore.hpp>
+#include <rtt/base/ActivityInterface.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/plugin/ServicePlugin.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace OCL
+{
+    using namespace RTT;
+
+    /**
+     * A service that measures the execution time and the start jitter
+     * of each cycle of the component it is loaded in. It can be
+     * loaded in any component with the DeploymentComponent's
+     * loadService() operation or with a 'Service' element in the
+     * deployment XML file.
+     *
+     * All measurements are done in the thread of the component: the
+     * start of a cycle is taken by a function run by the component's
+     * ExecutionEngine, the end of a cycle by a child TaskCore whose
+     * updateHook() runs right after the component's updateHook().
+     * No locks are taken and no memory is allocated. The histogram
+     * has a fixed number of bins, so that other threads can read it
+     * while it is being updated.
+     *
+     * The statistics are available as properties of the service
+     * and are written every PublishEvery cycles to its ports.
+     */
+    class TimingService: public RTT::Service
+    {
+        /**
+         * Marks the start of a cycle. Executed by the ExecutionEngine
+         * after the messages and before the hooks of the component.
+         */
+        class CycleStart: public base::ExecutableInterface
+        {
+            TimingService* ts;
+        public:
+            CycleStart(TimingService* t) : ts(t) {}
+            bool execute() { ts->cycleStarted(); return true; }
+        };
+
+        /**
+         * Marks the end of a cycle. As a child of the component's
+         * ExecutionEngine, its updateHook() runs after the one of
+         * the component.
+         */
+        class CycleEnd: public base::TaskCore
+        {
+            TimingService* ts;
+        public:
+            CycleEnd(ExecutionEngine* ee, TimingService* t) : base::TaskCore(ee, Running), ts(t) {}
+            void updateHook() { ts->cycleEnded(); }
+        };
+
+        CycleStart* mstart;
+        CycleEnd* mend;
+        os::AtomicInt mreset;
+        os::TimeService::nsecs cycle_start, last_start;
+        bool in_cycle;
+
+        // statistics
+        unsigned int cycles, overruns;
+        unsigned int jitter_samples;
+        double exec_last, exec_max, exec_mean;
+        double jitter_last, jitter_max, jitter_mean;
+        std::vector<double> histogram;
+
+        // configuration
+        double bin_width;
+        const unsigned int nbins;
+        unsigned int publish_every;
+
+        OutputPort<double> exec_port;
+        OutputPort<double> jitter_port;
+        OutputPort<unsigned int> overruns_port;
+        OutputPort<std::vector<double> > histogram_port;
+
+    public:
+        TimingService(TaskContext* parent) :
+            RTT::Service("timing", parent),
+            mstart(0), mend(0), mreset(0), cycle_start(0), last_start(0), in_cycle(false),
+            bin_width(0.0001), nbins(50), publish_every(100),
+            exec_port("exec_time"), jitter_port("jitter"), overruns_port("overruns"), histogram_port("histogram")
+        {
+            doc("A service that measures the execution time and start jitter of each cycle of its component.");
+            histogram.resize( nbins );
+            clear();
+
+            addProperty("Cycles", cycles).doc("Number of measured cycles.");
+            addProperty("Overruns", overruns).doc("Number of cycles which took longer than the period.");
+            addProperty("ExecTimeMax", exec_max).doc("Longest execution time of a cycle, in seconds.");
+            addProperty("ExecTimeMean", exec_mean).doc("Mean execution time of a cycle, in seconds.");
+            addProperty("JitterMax", jitter_max).doc("Largest deviation of the cycle start interval from the period, in seconds.");
+            addProperty("JitterMean", jitter_mean).doc("Mean deviation of the cycle start interval from the period, in seconds.");
+            addProperty("Histogram", histogram).doc("Number of cycles per execution time bin. The last bin counts all longer cycles.");
+            addProperty("HistogramBinWidth", bin_width).doc("Width of a histogram bin, in seconds. Applied by reset().");
+            addConstant("HistogramBins", nbins);
+            addProperty("PublishEvery", publish_every).doc("Write the statistics to the ports every this number of cycles.");
+
+            addPort(exec_port).doc("Execution time of the last cycle, in seconds.");
+            addPort(jitter_port).doc("Start jitter of the last cycle, in seconds.");
+            addPort(overruns_port).doc("Number of cycles which took longer than the period.");
+            addPort(histogram_port).doc("The execution time histogram.");
+            histogram_port.setDataSample( histogram );
+
+            addOperation("reset", &TimingService::reset, this).doc("Clear all statistics and apply the histogram bin width at the start of the next cycle.");
+
+            if ( parent ) {
+                mstart = new CycleStart(this);
+                mend = new CycleEnd(parent->engine(), this);
+                if ( !parent->engine()->runFunction(mstart) )
+                    log(Error) << "TimingService: could not install the cycle start function in " << parent->getName() << endlog();
+            }
+        }
+
+        ~TimingService()
+        {
+            if ( mstart && mstart->isLoaded() )
+                mstart->getEngine()->removeFunction(mstart);
+            delete mstart;
+            delete mend;
+        }
+
+        void reset()
+        {
+            mreset.set(1);
+        }
+
+    private:
+        void clear()
+        {
+            cycles = overruns = jitter_samples = 0;
+            exec_last = exec_max = exec_mean = 0.0;
+            jitter_last = jitter_max = jitter_mean = 0.0;
+            std::fill( histogram.begin(), histogram.end(), 0.0 );
+            last_start = 0;
+            in_cycle = false;
+        }
+
+        bool ownerRunning()
+        {
+            TaskContext* owner = getOwner();
+            return owner && owner->isRunning();
+        }
+
+        void cycleStarted()
+        {
+            if ( mreset.read() ) {
+                mreset.set(0);
+                clear();
+            }
+            if ( !ownerRunning() ) {
+                last_start = 0;
+                in_cycle = false;
+                return;
+            }
+            cycle_start = os::TimeService::Instance()->getNSecs();
+            base::ActivityInterface* act = getOwner()->engine()->getActivity();
+            double period = act ? act->getPeriod() : 0.0;
+            if ( last_start != 0 && period != 0.0 ) {
+                jitter_last = std::fabs( (cycle_start - last_start) * 1e-9 - period );
+                if ( jitter_last > jitter_max )
+                    jitter_max = jitter_last;
+                // the first cycle after a (re)start has no jitter sample.
+                ++jitter_samples;
+                jitter_mean += (jitter_last - jitter_mean) / jitter_samples;
+            }
+            last_start = cycle_start;
+            in_cycle = true;
+        }
+
+        void cycleEnded()
+        {
+            if ( !in_cycle )
+                return;
+            in_cycle = false;
+            exec_last = (os::TimeService::Instance()->getNSecs() - cycle_start) * 1e-9;
+            ++cycles;
+            if ( exec_last > exec_max )
+                exec_max = exec_last;
+            exec_mean += (exec_last - exec_mean) / cycles;
+
+            unsigned int bin = bin_width > 0.0 ? (unsigned int)(exec_last / bin_width) : 0;
+            if ( bin >= histogram.size() )
+                bin = histogram.size() - 1;
+            histogram[bin] += 1.0;
+
+            base::ActivityInterface* act = getOwner()->engine()->getActivity();
+            if ( act && act->getPeriod() != 0.0 && exec_last > act->getPeriod() )
+                ++overruns;
+
+            if ( publish_every != 0 && cycles % publish_every == 0 ) {
+                exec_port.write( exec_last );
+                jitter_port.write( jitter_last );
+                overruns_port.write( overruns );
+                histogram_port.write( histogram );
+            }
+        }
+    };
+}
+
+ORO_SERVICE_NAMED_PLUGIN( OCL::TimingService, "timing")
@@ -0,0 +1,220 @@
+#include "CompletionIndex.hpp"
+#include <rtt/Activity.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/internal/GlobalService.hpp>
+#include <algorithm>
+
+namespace OCL
+{
+    using namespace RTT;
+    using namespace std;
+
+    // nodes filled or refreshed per step of the index thread.
+    static const unsigned int fills_per_step = 4;
+
+    CompletionIndex::CompletionIndex(double refresh)
+        : mroot(0), mrefresh(refresh), mact(0)
+    {
+        mact = new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.1, this, "TaskBrowserIndex");
+        mact->start();
+    }
+
+    CompletionIndex::~CompletionIndex()
+    {
+        mact->stop();
+        delete mact;
+    }
+
+    void CompletionIndex::setRoot(TaskContext* root)
+    {
+        os::MutexLock lock(mlock);
+        if ( root == mroot )
+            return;
+        mroot = root;
+        mnodes.clear();
+        mpending.clear();
+        mpending.push_back("");
+    }
+
+    void CompletionIndex::invalidate(const std::string& path)
+    {
+        os::MutexLock lock(mlock);
+        const std::string paths[] = { path, "" };
+        for (unsigned int i = 0; i < (path.empty() ? 1u : 2u); ++i) {
+            Nodes::iterator it = mnodes.find(paths[i]);
+            if ( it == mnodes.end() || it->second->stamp == 0 )
+                continue;
+            boost::shared_ptr<Node> node( new Node(*it->second) );
+            node->stamp = 0;
+            it->second = node;
+        }
+    }
+
+    /* must hold mlock */
+    bool CompletionIndex::stale(const Node& node) const
+    {
+        return node.stamp == 0 || os::TimeService::Instance()->secondsSince(node.stamp) >= mrefresh;
+    }
+
+    /* queues path for the index thread, must hold mlock */
+    void CompletionIndex::queue(const std::string& path)
+    {
+        if ( find(mpending.begin(), mpending.end(), path) == mpending.end() )
+            mpending.push_back(path);
+    }
+
+    CompletionIndex::NodePtr CompletionIndex::lookup(const std::string& path)
+    {
+        TaskContext* root;
+        {
+            os::MutexLock lock(mlock);
+            Nodes::iterator it = mnodes.find(path);
+            if ( it != mnodes.end() ) {
+                if ( stale(*it->second) )
+                    queue(path);
+                prefetch(path, *it->second);
+                return it->second;
+            }
+            root = mroot;
+        }
+        if ( !root )
+            return NodePtr();
+        NodePtr node;
+        {
+            os::MutexLock busy(mbusy);
+            node = fill(root, path);
+        }
+        store(root, path, node);
+        if ( node ) {
+            os::MutexLock lock(mlock);
+            prefetch(path, *node);
+        }
+        return node;
+    }
+
+    void CompletionIndex::match(const std::vector<std::string>& sorted, const std::string& prefix,
+                                std::vector<std::string>& result)
+    {
+        for (std::vector<std::string>::const_iterator it = lower_bound(sorted.begin(), sorted.end(), prefix);
+             it != sorted.end() && it->compare(0, prefix.size(), prefix) == 0; ++it)
+            result.push_back( *it );
+    }
+
+    bool CompletionIndex::contains(const std::vector<std::string>& sorted, const std::string& name)
+    {
+        return binary_search(sorted.begin(), sorted.end(), name);
+    }
+
+    /* resolves path from root like find_peers() does and lists its
+     * interface, in the calling thread, must hold mbusy */
+    CompletionIndex::NodePtr CompletionIndex::fill(TaskContext* root, const std::string& path)
+    {
+        try {
+            TaskContext* peer = root;
+            Service::shared_ptr svc = root->provides();
+            bool is_peer = true;
+            std::string::size_type start = 0, end;
+            while ( (end = path.find('.', start)) != std::string::npos ) {
+                std::string item = path.substr(start, end - start);
+                if ( svc->hasService(item) ) {
+                    svc = svc->provides(item);
+                    is_peer = false;
+                } else if ( is_peer && peer->hasPeer(item) ) {
+                    peer = peer->getPeer(item);
+                    svc = peer->provides();
+                } else if ( internal::GlobalService::Instance()->hasService(item) ) {
+                    svc = internal::GlobalService::Instance()->provides(item);
+                    is_peer = false;
+                } else
+                    return NodePtr();
+                start = end + 1;
+            }
+
+            boost::shared_ptr<Node> node( new Node() );
+            node->is_peer = is_peer;
+            if ( is_peer ) {
+                node->peers = peer->getPeerList();
+                node->ports = peer->ports()->getPortNames();
+            }
+            node->services = svc->getProviderNames();
+            node->operations = svc->getNames();
+            node->attributes = svc->getAttributeNames();
+            svc->properties()->list(node->properties);
+            node->stamp = os::TimeService::Instance()->getTicks();
+
+            sort(node->peers.begin(), node->peers.end());
+            sort(node->ports.begin(), node->ports.end());
+            sort(node->services.begin(), node->services.end());
+            sort(node->operations.begin(), node->operations.end());
+            sort(node->attributes.begin(), node->attributes.end());
+            sort(node->properties.begin(), node->properties.end());
+            return node;
+        } catch(...) {
+            // e.g. a remote peer which went away.
+            return NodePtr();
+        }
+    }
+
+    void CompletionIndex::store(TaskContext* root, const std::string& path, NodePtr node)
+    {
+        os::MutexLock lock(mlock);
+        if ( root != mroot )
+            return; // filled for a previous root.
+        if ( !node ) {
+            mnodes.erase(path);
+            return;
+        }
+        mnodes[path] = node;
+        // the first level is what the user types first.
+        if ( path.empty() )
+            prefetch(path, *node);
+    }
+
+    /* queues the children of path which are not indexed yet, must hold mlock */
+    void CompletionIndex::prefetch(const std::string& path, const Node& node)
+    {
+        const std::vector<std::string>* lists[] = { &node.peers, &node.services };
+        for (unsigned int l = 0; l < 2; ++l)
+            for (std::vector<std::string>::const_iterator it = lists[l]->begin(); it != lists[l]->end(); ++it) {
+                std::string child = path + *it + ".";
+                if ( mnodes.find(child) == mnodes.end() )
+                    queue(child);
+            }
+    }
+
+    bool CompletionIndex::initialize()
+    {
+        return true;
+    }
+
+    void CompletionIndex::step()
+    {
+        // the TaskBrowser is executing a command, try again next step.
+        if ( !mbusy.trylock() )
+            return;
+        for (unsigned int n = 0; n < fills_per_step; ++n) {
+            std::string path;
+            TaskContext* root;
+            {
+                os::MutexLock lock(mlock);
+                root = mroot;
+                if ( !root )
+                    break;
+                if ( mpending.empty() )
+                    break;
+                path = mpending.front();
+                mpending.pop_front();
+                // filled or refreshed meanwhile by a lookup.
+                Nodes::iterator it = mnodes.find(path);
+                if ( it != mnodes.end() && !stale(*it->second) )
+                    continue;
+            }
+            store(root, path, fill(root, path));
+        }
+        mbusy.unlock();
+    }
+
+    void CompletionIndex::finalize()
+    {
+    }
+}
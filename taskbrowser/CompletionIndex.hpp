@@ -0,0 +1,125 @@
+#ifndef ORO_TASKBROWSER_COMPLETIONINDEX_HPP
+#define ORO_TASKBROWSER_COMPLETIONINDEX_HPP
+
+#include <rtt/TaskContext.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/base/ActivityInterface.hpp>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OCL
+{
+    /**
+     * @brief Caches the names the TaskBrowser completes on.
+     *
+     * For each path completed on, such as "" for the current context
+     * or "peer.service.", a Node holds the sorted names of the peers,
+     * services, operations, attributes, properties and ports found
+     * there. A node is filled in one pass over the interface of its
+     * peer or service, such that completing is a binary search instead
+     * of a series of (possibly remote) interface queries.
+     *
+     * A low priority thread fills the nodes one level below the ones
+     * which were looked up, before the user types them, a few per
+     * step. Nodes are refreshed lazily: looking up a node which was
+     * invalidated or is older than the refresh period returns it as
+     * it is and queues it for the thread. It only queries components
+     * while it holds busy(), which the TaskBrowser keeps locked while
+     * it executes a command.
+     */
+    class CompletionIndex
+        : public RTT::base::RunnableInterface
+    {
+    public:
+        struct Node {
+            bool is_peer;   // a TaskContext, not a Service
+            std::vector<std::string> peers;
+            std::vector<std::string> services;
+            std::vector<std::string> operations;
+            std::vector<std::string> attributes;
+            std::vector<std::string> properties;
+            std::vector<std::string> ports;
+            RTT::os::TimeService::ticks stamp;
+        };
+        typedef boost::shared_ptr<const Node> NodePtr;
+
+        /**
+         * Keeps the index from querying components while in scope.
+         * A null index is allowed.
+         */
+        class Pause {
+            CompletionIndex* mci;
+        public:
+            Pause(CompletionIndex* ci) : mci(ci) { if (mci) mci->busy().lock(); }
+            ~Pause() { if (mci) mci->busy().unlock(); }
+        };
+
+        /**
+         * @param refresh Age in seconds after which a node is refreshed.
+         */
+        CompletionIndex(double refresh);
+        ~CompletionIndex();
+
+        /**
+         * Drops all nodes and starts over from \a root, which all
+         * paths are relative to.
+         */
+        void setRoot(RTT::TaskContext* root);
+
+        /**
+         * Returns the node of \a path, filling it in the calling thread
+         * if it was not indexed yet, or a null pointer if the path does
+         * not lead to a peer or service.
+         */
+        NodePtr lookup(const std::string& path);
+
+        /**
+         * Marks the node of \a path and the root node for refreshing,
+         * e.g. after a command on \a path which may have loaded
+         * components or added peers. They are refreshed when they are
+         * looked up again.
+         */
+        void invalidate(const std::string& path);
+
+        /**
+         * Appends the names in \a sorted which start with \a prefix
+         * to \a result.
+         */
+        static void match(const std::vector<std::string>& sorted, const std::string& prefix,
+                          std::vector<std::string>& result);
+
+        /**
+         * Held while components are queried.
+         */
+        RTT::os::Mutex& busy() { return mbusy; }
+
+        static bool contains(const std::vector<std::string>& sorted, const std::string& name);
+
+        bool initialize();
+        void step();
+        void finalize();
+
+    private:
+        typedef std::map<std::string, NodePtr> Nodes;
+        Nodes mnodes;
+        std::deque<std::string> mpending;
+        RTT::TaskContext* mroot;
+        double mrefresh;
+        RTT::os::Mutex mlock;
+        RTT::os::Mutex mbusy;
+        RTT::base::ActivityInterface* mact;
+
+        bool stale(const Node& node) const;
+        void queue(const std::string& path);
+        NodePtr fill(RTT::TaskContext* root, const std::string& path);
+        void store(RTT::TaskContext* root, const std::string& path, NodePtr node);
+        void prefetch(const std::string& path, const Node& node);
+    };
+}
+
+#endif
@@ -0,0 +1,321 @@
+#include "PortTracer.hpp"
+#include <rtt/Activity.hpp>
+#include <rtt/ConnPolicy.hpp>
+#include <rtt/Logger.hpp>
+#include <rtt/types/TypeInfo.hpp>
+#include <rtt/os/fosi.h>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+
+namespace OCL
+{
+    using namespace RTT;
+    using namespace RTT::base;
+    using namespace RTT::internal;
+    using namespace std;
+
+    static const unsigned int trace_version = 1;
+
+    template<class T>
+    static void put(std::ostream& os, const T& v)
+    {
+        os.write( (const char*) &v, sizeof(T) );
+    }
+
+    static void putString(std::ostream& os, const std::string& s)
+    {
+        unsigned int n = s.size();
+        put(os, n);
+        os.write( s.data(), n );
+    }
+
+    template<class T>
+    static bool get(std::istream& is, T& v)
+    {
+        return !is.read( (char*) &v, sizeof(T) ).fail();
+    }
+
+    static bool getString(std::istream& is, std::string& s)
+    {
+        unsigned int n;
+        if ( !get(is, n) )
+            return false;
+        s.resize(n);
+        return n == 0 || !is.read( &s[0], n ).fail();
+    }
+
+    /* the kind of a primitive part, or 0 if it must be decomposed */
+    static char partKind(DataSourceBase::shared_ptr dsb)
+    {
+        if ( DataSource<double>::narrow(dsb.get()) ) return 'd';
+        if ( DataSource<float>::narrow(dsb.get()) ) return 'f';
+        if ( DataSource<int>::narrow(dsb.get()) ) return 'i';
+        if ( DataSource<unsigned int>::narrow(dsb.get()) ) return 'u';
+        if ( DataSource<bool>::narrow(dsb.get()) ) return 'b';
+        if ( DataSource<char>::narrow(dsb.get()) ) return 'c';
+        if ( DataSource<std::string>::narrow(dsb.get()) ) return 's';
+        return 0;
+    }
+
+    PortTracer::PortTracer(OutputPortInterface* port, const std::string& name, unsigned int buffer)
+        : mname(name), minput(0), mbuffer(1024*1024), mmax_samples(0), mmax_seconds(0.0),
+          mstart(0), mquit(false), mact(0)
+    {
+        minput = dynamic_cast<InputPortInterface*>( port->antiClone() );
+        if ( minput && !port->connectTo( minput, ConnPolicy::buffer(buffer) ) ) {
+            log(Error) << "PortTracer: could not connect to port " << name << endlog();
+            delete minput;
+            minput = 0;
+        }
+        if ( minput )
+            msample = port->getTypeInfo()->buildValue();
+        mact = new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.0, this, "PortTracer");
+    }
+
+    PortTracer::~PortTracer()
+    {
+        stop();
+        delete mact;
+        mparts.clear();
+        msizes.clear();
+        msample = 0;
+        if ( minput ) {
+            minput->disconnect();
+            delete minput;
+        }
+    }
+
+    bool PortTracer::start(const std::string& file, unsigned int max_samples, double max_seconds)
+    {
+        if ( !minput || !msample || mact->isActive() )
+            return false;
+        mout.rdbuf()->pubsetbuf( &mbuffer[0], mbuffer.size() );
+        mout.open( file.c_str(), ios::out | ios::binary | ios::trunc );
+        if ( !mout ) {
+            log(Error) << "PortTracer: could not open " << file << endlog();
+            return false;
+        }
+        mfile = file;
+        mmax_samples = max_samples;
+        mmax_seconds = max_seconds;
+        msamples.set(0);
+
+        mout.write( "OCLTRACE", 8 );
+        put( mout, trace_version );
+        putString( mout, mname );
+        putString( mout, msample->getTypeName() );
+        mparts.clear();
+        msizes.clear();
+        decompose( msample, mname );
+        writeParts();
+
+        mtracing.set(1);
+        mstart = os::TimeService::Instance()->getTicks();
+        return mact->start();
+    }
+
+    void PortTracer::stop()
+    {
+        mact->stop();
+        mtracing.set(0);
+        if ( mout.is_open() )
+            mout.close();
+    }
+
+    bool PortTracer::isTracing() const
+    {
+        return mtracing.read() != 0;
+    }
+
+    unsigned int PortTracer::samples() const
+    {
+        return msamples.read();
+    }
+
+    /* flattens dsb into mparts, remembering the sizes of the sequences.
+     * The size of a sequence is remembered before those of the sequences
+     * it contains, see loop(). */
+    void PortTracer::decompose(DataSourceBase::shared_ptr dsb, const std::string& name)
+    {
+        Part part;
+        part.name = name;
+        part.ds = dsb;
+        part.kind = partKind(dsb);
+        vector<string> members = dsb->getMemberNames();
+        if ( part.kind || members.empty() ) {
+            // anything else without members is written as text.
+            if ( !part.kind )
+                part.kind = 't';
+            mparts.push_back( part );
+            return;
+        }
+        DataSource<int>::shared_ptr size = DataSource<int>::narrow( dsb->getMember("size").get() );
+        int n = size ? size->get() : 0;
+        if ( size )
+            msizes.push_back( make_pair(size, n) );
+        for (vector<string>::iterator it = members.begin(); it != members.end(); ++it)
+            if ( *it != "size" && *it != "capacity" )
+                decompose( dsb->getMember(*it), name + "." + *it );
+        if ( size ) {
+            for (int i = 0; i < n; ++i)
+                decompose( dsb->getMember( boost::lexical_cast<string>(i) ),
+                           name + "[" + boost::lexical_cast<string>(i) + "]" );
+        }
+    }
+
+    void PortTracer::writeParts()
+    {
+        mout.put('S');
+        put( mout, (unsigned int) mparts.size() );
+        for (vector<Part>::iterator it = mparts.begin(); it != mparts.end(); ++it) {
+            mout.put( it->kind );
+            putString( mout, it->name );
+        }
+    }
+
+    void PortTracer::writeSample(double t)
+    {
+        mout.put('D');
+        put( mout, t );
+        for (vector<Part>::iterator it = mparts.begin(); it != mparts.end(); ++it) {
+            DataSourceBase* ds = it->ds.get();
+            switch ( it->kind ) {
+            case 'd': put( mout, static_cast<DataSource<double>*>(ds)->get() ); break;
+            case 'f': put( mout, static_cast<DataSource<float>*>(ds)->get() ); break;
+            case 'i': put( mout, static_cast<DataSource<int>*>(ds)->get() ); break;
+            case 'u': put( mout, static_cast<DataSource<unsigned int>*>(ds)->get() ); break;
+            case 'b': mout.put( static_cast<DataSource<bool>*>(ds)->get() ? 1 : 0 ); break;
+            case 'c': mout.put( static_cast<DataSource<char>*>(ds)->get() ); break;
+            case 's': putString( mout, static_cast<DataSource<std::string>*>(ds)->get() ); break;
+            default: {
+                stringstream ss;
+                ss << it->ds;
+                putString( mout, ss.str() );
+            }
+            }
+        }
+    }
+
+    bool PortTracer::initialize()
+    {
+        mquit = false;
+        return true;
+    }
+
+    void PortTracer::step()
+    {
+    }
+
+    void PortTracer::loop()
+    {
+        os::TimeService* ts = os::TimeService::Instance();
+        while ( !mquit ) {
+            while ( !mquit && minput->read( msample, false ) == NewData ) {
+                double t = ts->secondsSince( mstart );
+                // a resized sequence invalidates the parts, and the sizes of
+                // the sequences it contains: those refer to its old elements.
+                // msizes lists outer sequences first, so stop at the first
+                // difference, before an inner size is touched.
+                bool resized = false;
+                for (unsigned int i = 0; !resized && i != msizes.size(); ++i)
+                    resized = msizes[i].first->get() != msizes[i].second;
+                if ( resized ) {
+                    mparts.clear();
+                    msizes.clear();
+                    decompose( msample, mname );
+                    writeParts();
+                }
+                writeSample( t );
+                msamples.inc();
+                if ( mmax_samples && (unsigned int) msamples.read() >= mmax_samples )
+                    mquit = true;
+            }
+            if ( mmax_seconds > 0.0 && ts->secondsSince( mstart ) >= mmax_seconds )
+                mquit = true;
+            if ( mquit )
+                break;
+            // the connection buffers the samples in between.
+            TIME_SPEC tv;
+            tv.tv_sec = 0;
+            tv.tv_nsec = 1000000;
+            rtos_nanosleep( &tv, 0 );
+        }
+        mout.flush();
+        mtracing.set(0);
+    }
+
+    bool PortTracer::breakLoop()
+    {
+        mquit = true;
+        return true;
+    }
+
+    void PortTracer::finalize()
+    {
+    }
+
+    bool PortTracer::exportTable(const std::string& trace, const std::string& table)
+    {
+        ifstream in( trace.c_str(), ios::in | ios::binary );
+        char magic[8];
+        unsigned int version = 0;
+        std::string port, type;
+        if ( !in.read( magic, 8 ) || std::string(magic, 8) != "OCLTRACE"
+             || !get(in, version) || version != trace_version
+             || !getString(in, port) || !getString(in, type) ) {
+            log(Error) << "PortTracer: " << trace << " is not a port trace file." << endlog();
+            return false;
+        }
+        ofstream out( table.c_str() );
+        if ( !out ) {
+            log(Error) << "PortTracer: could not open " << table << endlog();
+            return false;
+        }
+
+        // a trace which is still being written ends with a partial record,
+        // which is dropped: each line is only written once it was read.
+        std::vector<char> kinds;
+        std::string s;
+        char tag;
+        while ( in.get(tag) ) {
+            stringstream line;
+            if ( tag == 'S' ) {
+                unsigned int n;
+                if ( !get(in, n) )
+                    break;
+                std::vector<char> k(n);
+                line << " | TimeStamp";
+                for (unsigned int i = 0; i != n && in.get(k[i]) && getString(in, s); ++i)
+                    line << " | " << s;
+                if ( !in )
+                    break;
+                kinds.swap(k);
+                out << line.str() << " |" << endl;
+            } else if ( tag == 'D' ) {
+                double t;
+                if ( !get(in, t) )
+                    break;
+                line << " " << t;
+                for (unsigned int i = 0; i != kinds.size() && in; ++i) {
+                    line << " ";
+                    switch ( kinds[i] ) {
+                    case 'd': { double v; if ( get(in, v) ) line << v; break; }
+                    case 'f': { float v; if ( get(in, v) ) line << v; break; }
+                    case 'i': { int v; if ( get(in, v) ) line << v; break; }
+                    case 'u': { unsigned int v; if ( get(in, v) ) line << v; break; }
+                    case 'b': { char v; if ( in.get(v) ) line << (v ? "true" : "false"); break; }
+                    case 'c': { char v; if ( in.get(v) ) line << v; break; }
+                    default: if ( getString(in, s) ) line << s; break;
+                    }
+                }
+                if ( !in )
+                    break;
+                out << line.str() << " " << endl;
+            } else {
+                log(Error) << "PortTracer: " << trace << " is corrupt." << endlog();
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef ORO_TASKBROWSER_PORTTRACER_HPP
+#define ORO_TASKBROWSER_PORTTRACER_HPP
+
+#include <rtt/base/OutputPortInterface.hpp>
+#include <rtt/base/InputPortInterface.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/base/ActivityInterface.hpp>
+#include <rtt/internal/DataSource.hpp>
+#include <rtt/os/Atomic.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace OCL
+{
+    /**
+     * @brief Records the samples of an output port to a binary file.
+     *
+     * A buffered connection is made to the port and a thread drains it,
+     * writing each sample with the time it was read, in seconds since
+     * the start of the trace. The sample is decomposed into its
+     * primitive parts once, and again only when a sequence in it
+     * changes size, so writing a sample does not format it.
+     *
+     * The file starts with "OCLTRACE", a version number and the port
+     * and type name, followed by records in host byte order. An 'S'
+     * record lists the kind and name of each part, a 'D' record holds
+     * a time stamp and the values of the parts of one sample.
+     * exportTable() converts a file to the table format of the
+     * ReportingComponent.
+     */
+    class PortTracer
+        : public RTT::base::RunnableInterface
+    {
+    public:
+        /**
+         * Connects to \a port with a buffer of \a buffer samples.
+         */
+        PortTracer(RTT::base::OutputPortInterface* port, const std::string& name, unsigned int buffer = 1024);
+        ~PortTracer();
+
+        /**
+         * Starts writing to \a file. Stops by itself after
+         * \a max_samples samples or \a max_seconds seconds,
+         * zero meaning no limit.
+         */
+        bool start(const std::string& file, unsigned int max_samples, double max_seconds);
+
+        /**
+         * Stops tracing and closes the file.
+         */
+        void stop();
+
+        /**
+         * True until a limit is reached or stop() is called.
+         */
+        bool isTracing() const;
+
+        unsigned int samples() const;
+
+        const std::string& getName() const { return mname; }
+        const std::string& getFile() const { return mfile; }
+
+        /**
+         * Writes the trace in file \a trace as a table to file \a table:
+         * a header line with the part names for each 'S' record and a
+         * line with the time stamp and values for each 'D' record.
+         */
+        static bool exportTable(const std::string& trace, const std::string& table);
+
+        bool initialize();
+        void step();
+        void loop();
+        bool breakLoop();
+        void finalize();
+
+    private:
+        struct Part {
+            char kind;
+            std::string name;
+            RTT::base::DataSourceBase::shared_ptr ds;
+        };
+
+        std::string mname;
+        std::string mfile;
+        RTT::base::InputPortInterface* minput;
+        RTT::base::DataSourceBase::shared_ptr msample;
+        std::vector<Part> mparts;
+        std::vector<std::pair<RTT::internal::DataSource<int>::shared_ptr, int> > msizes;
+        std::vector<char> mbuffer;
+        std::ofstream mout;
+        unsigned int mmax_samples;
+        double mmax_seconds;
+        RTT::os::TimeService::ticks mstart;
+        RTT::os::AtomicInt msamples;
+        RTT::os::AtomicInt mtracing;
+        bool mquit;
+        RTT::base::ActivityInterface* mact;
+
+        void decompose(RTT::base::DataSourceBase::shared_ptr dsb, const std::string& name);
+        void writeParts();
+        void writeSample(double t);
+    };
+}
+
+#endif
@@ -73,6 +73,8 @@
 #include <rtt/internal/GlobalService.hpp>
 #include <rtt/types/GlobalsRepository.hpp>
 #include <rtt/internal/GlobalEngine.hpp>
+#include <rtt/internal/OperationCallerC.hpp>
+#include <rtt/SendStatus.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <iostream>
@@ -82,6 +84,12 @@
 #include <deque>
 #include <stdio.h>
 #include <algorithm>
+#include <cctype>
+#ifndef _WIN32
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+#endif
 
 #if defined(HAS_READLINE) && !defined(NO_GPL)
 # define USE_READLINE
@@ -131,6 +139,8 @@ namespace OCL
     std::string TaskBrowser::component_found;
     std::string TaskBrowser::peerpath;
     std::string TaskBrowser::text;
+    CompletionIndex* TaskBrowser::cindex = 0;
+    CompletionIndex::NodePtr TaskBrowser::cnode;
 #endif
     RTT::TaskContext* TaskBrowser::taskcontext = 0;
     Service::shared_ptr TaskBrowser::taskobject;
@@ -146,6 +156,8 @@ namespace OCL
     string TaskBrowser::green;
     string TaskBrowser::blue;
     std::deque<TaskContext*> taskHistory;
+    // seconds '.collect' waits for the calls of a batch by default.
+    static const double default_collect_timeout = 10.0;
     std::string TaskBrowser::prompt("> ");
     std::string TaskBrowser::coloron;
     std::string TaskBrowser::underline;
@@ -382,6 +394,9 @@ namespace OCL
             tbcoms.push_back(".services");
             tbcoms.push_back(".typekits");
             tbcoms.push_back(".types");
+            tbcoms.push_back(".exportTrace ");
+            tbcoms.push_back(".batch");
+            tbcoms.push_back(".collect");
 
             // then see which one matches the already typed line :
             for( std::vector<std::string>::iterator it = tbcoms.begin();
@@ -455,6 +470,7 @@ namespace OCL
             completes.push_back("list");
             completes.push_back("trace");
             completes.push_back("untrace");
+            completes.push_back("top");
             if (taskcontext == context)
                 completes.push_back("leave");
             else
@@ -480,6 +496,8 @@ namespace OCL
                 completes.push_back("trace ");
             if ( std::string( "untrace " ).find(text) == 0 )
                 completes.push_back("untrace ");
+            if ( std::string( "top " ).find(text) == 0 )
+                completes.push_back("top ");
             if ( std::string( "GlobalService" ).find(text) == 0 )
                 completes.push_back("GlobalService");
             if ( std::string( "GlobalsRepository" ).find(text) == 0 )
@@ -496,28 +514,21 @@ namespace OCL
     void TaskBrowser::find_ops()
     {
         // the last (incomplete) text is stored in 'component'.
-        // all attributes :
-        std::vector<std::string> attrs;
-        attrs = taskobject->getAttributeNames();
-        for (std::vector<std::string>::iterator i = attrs.begin(); i!= attrs.end(); ++i ) {
-            if ( i->find( component ) == 0 )
-                completes.push_back( peerpath + *i );
-        }
-        // all properties if RTT::TaskContext/Service:
-        std::vector<std::string> props;
-        taskobject->properties()->list(props);
-        for (std::vector<std::string>::iterator i = props.begin(); i!= props.end(); ++i ) {
-            if ( i->find( component ) == 0 ) {
-                completes.push_back( peerpath + *i );
-            }
-        }
-
-        // methods:
-        vector<string> comps = taskobject->getNames();
-        for (std::vector<std::string>::iterator i = comps.begin(); i!= comps.end(); ++i ) {
-            if ( i->find( component ) == 0  )
-                completes.push_back( peerpath + *i );
-        }
+        // all attributes, properties, methods and ports of the indexed node:
+        vector<string> comps;
+        if ( cnode ) {
+            CompletionIndex::match( cnode->attributes, component, comps );
+            CompletionIndex::match( cnode->properties, component, comps );
+            CompletionIndex::match( cnode->operations, component, comps );
+            // most ports are services too, only add the others.
+            vector<string> ports;
+            CompletionIndex::match( cnode->ports, component, ports );
+            for (std::vector<std::string>::iterator i = ports.begin(); i!= ports.end(); ++i )
+                if ( !CompletionIndex::contains( cnode->services, *i ) )
+                    comps.push_back( *i );
+        }
+        for (std::vector<std::string>::iterator i = comps.begin(); i!= comps.end(); ++i )
+            completes.push_back( peerpath + *i );
 
         // types:
         comps = Types()->getDottedTypes();
@@ -553,7 +564,7 @@ namespace OCL
             for (std::vector<std::string>::iterator i = comps.begin(); i!= comps.end(); ++i ) {
                 completes.push_back( "GlobalsRepository." + *i );
             }
-        } else if ( taskobject == peer->provides() && peer == context ) {
+        } else if ( peerpath.empty() ) {
             // Global methods:
             comps = GlobalService::Instance()->getNames();
             for (std::vector<std::string>::iterator i = comps.begin(); i!= comps.end(); ++i ) {
@@ -563,7 +574,7 @@ namespace OCL
         }
 
         // Global methods:
-        if ( taskobject == peer->provides() && peer == context) {
+        if ( peerpath.empty() ) {
             comps = GlobalService::Instance()->getNames();
             for (std::vector<std::string>::iterator i = comps.begin(); i!= comps.end(); ++i ) {
                 if ( i->find( component ) == 0  )
@@ -621,8 +632,7 @@ namespace OCL
     void TaskBrowser::find_peers( std::string::size_type startpos )
     {
         peerpath.clear();
-        peer = context;
-        taskobject = context->provides();
+        cnode = cindex->lookup( peerpath );
 
         std::string to_parse = text.substr(startpos);
         startpos = 0;
@@ -631,7 +641,7 @@ namespace OCL
         component.clear();
         peerpath.clear();
         // This loop separates the peer/service from the member/method
-        while (endpos != std::string::npos )
+        while ( cnode && endpos != std::string::npos )
             {
                 bool itemfound = false;
                 endpos = to_parse.find(".");
@@ -641,18 +651,16 @@ namespace OCL
                 }
                 std::string item = to_parse.substr(startpos, endpos);
 
-                if ( taskobject->hasService( item ) ) {
-                    taskobject = taskobject->provides(item);
-                    itemfound = true;
-                } else
-                    if ( peer->hasPeer( item ) ) {
-                        peer = peer->getPeer( item );
-                        taskobject = peer->provides();
-                        itemfound = true;
-                    } else if ( GlobalService::Instance()->hasService(item) ) {
-                        taskobject = GlobalService::Instance()->provides(item);
+                // the index resolves services, peers and global services like the parser.
+                if ( CompletionIndex::contains( cnode->services, item )
+                     || ( cnode->is_peer && CompletionIndex::contains( cnode->peers, item ) )
+                     || GlobalService::Instance()->hasService(item) ) {
+                    CompletionIndex::NodePtr next = cindex->lookup( peerpath + item + "." );
+                    if ( next ) {
+                        cnode = next;
                         itemfound = true;
                     }
+                }
                 if ( itemfound ) { // if "." found and correct path
                     peerpath += to_parse.substr(startpos, endpos) + ".";
                     if ( endpos != std::string::npos )
@@ -671,8 +679,7 @@ namespace OCL
                 }
             }
 
-        // now we got the peer and taskobject pointers,
-        // the completed path in peerpath
+        // now we got the indexed node of the completed path in peerpath
         // the last partial path in component
 //         cout << "text: '" << text <<"'"<<endl;
 //         cout << "to_parse: '" << text <<"'"<<endl;
@@ -680,39 +687,31 @@ namespace OCL
         // cout <<endl<< "Component: '" << component <<"'"<<endl;
         // cout << "Component_found: '" << component_found <<"'"<<endl;
 
+        if ( !cnode )
+            return;
         RTT::TaskContext::PeerList v;
-        if ( taskobject == peer->provides() ) {
+        if ( cnode->is_peer ) {
             // add peer's completes:
-            v = peer->getPeerList();
+            CompletionIndex::match( cnode->peers, component, v );
             for (RTT::TaskContext::PeerList::iterator i = v.begin(); i != v.end(); ++i) {
-                if ( i->find( component ) == 0 ) { // only add if match
-                    completes.push_back( peerpath + *i );
-                    completes.push_back( peerpath + *i + "." );
-                    //cerr << "added " << peerpath+*i+"."<<endl;
-                }
-            }
-        }
-        // add taskobject's completes:
-        v = taskobject->getProviderNames();
-        for (RTT::TaskContext::PeerList::iterator i = v.begin(); i != v.end(); ++i) {
-            if ( i->find( component ) == 0 ) { // only add if match
                 completes.push_back( peerpath + *i );
-                if ( *i != "this" ) // "this." confuses our parsing lateron
-                    completes.push_back( peerpath + *i + "." );
-                //cerr << "added " << peerpath+*i+"."<<endl;
+                completes.push_back( peerpath + *i + "." );
             }
         }
+        // add taskobject's completes:
+        v.clear();
+        CompletionIndex::match( cnode->services, component, v );
         // add global service completes:
-        if ( peer == context && taskobject == peer->provides() ) {
-            v = GlobalService::Instance()->getProviderNames();
-            for (RTT::TaskContext::PeerList::iterator i = v.begin(); i != v.end(); ++i) {
-                if ( i->find( component ) == 0 ) { // only add if match
-                    completes.push_back( peerpath + *i );
-                    if ( *i != "this" ) // "this." confuses our parsing lateron
-                        completes.push_back( peerpath + *i + "." );
-                    //cerr << "added " << peerpath+*i+"."<<endl;
-                }
-            }
+        if ( peerpath.empty() ) {
+            RTT::TaskContext::PeerList g = GlobalService::Instance()->getProviderNames();
+            for (RTT::TaskContext::PeerList::iterator i = g.begin(); i != g.end(); ++i)
+                if ( i->find( component ) == 0 ) // only add if match
+                    v.push_back( *i );
+        }
+        for (RTT::TaskContext::PeerList::iterator i = v.begin(); i != v.end(); ++i) {
+            completes.push_back( peerpath + *i );
+            if ( *i != "this" ) // "this." confuses our parsing lateron
+                completes.push_back( peerpath + *i + "." );
         }
         return;
     }
@@ -735,6 +734,7 @@ namespace OCL
           lastc(0), storedname(""), storedline(-1),
           usehex(false),
           histfile(0),
+          batching(false),
           macrorecording(false)
     {
         tb = this;
@@ -747,6 +747,8 @@ namespace OCL
         rl_catch_signals = 0;
         rl_getc_function = &TaskBrowser::rl_getc;
 #endif
+        cindex = new CompletionIndex( 10.0 );
+        cindex->setRoot( context );
         rl_completion_append_character = '\0'; // avoid adding spaces
         rl_attempted_completion_function = &TaskBrowser::orocos_hmi_completion;
 
@@ -776,6 +778,8 @@ namespace OCL
     }
 
     TaskBrowser::~TaskBrowser() {
+        for (PortTraces::iterator it = tracers.begin(); it != tracers.end(); ++it)
+            delete it->second;
 #ifdef USE_READLINE
         if (line_read)
             {
@@ -784,6 +788,9 @@ namespace OCL
         if ( write_history(histfile) != 0 ) {
             write_history("~/.tb_history");
         }
+        delete cindex;
+        cindex = 0;
+        cnode.reset();
 #endif
     }
 
@@ -827,6 +834,24 @@ namespace OCL
             str = str.substr(pos1, pos2 - pos1 + 1);
     }
 
+#ifdef USE_READLINE
+    /**
+     * The path of the peer or service a command is executed on, as
+     * the completion index names it: "peer.service." for
+     * "peer.service.op(1)", "" for "op(1)" or "var = 1".
+     */
+    static std::string commandPath(const std::string& command)
+    {
+        string::size_type end = 0;
+        while ( end < command.size() && ( isalnum(command[end]) || command[end] == '_' || command[end] == '.' ) )
+            ++end;
+        string::size_type dot = command.rfind('.', end == 0 ? 0 : end - 1);
+        if ( dot == string::npos || dot >= end )
+            return "";
+        return command.substr(0, dot + 1);
+    }
+#endif
+
 
     /**
      * @brief Call this method from ORO_main() to
@@ -858,6 +883,11 @@ namespace OCL
                     // sets prompt for readline:
 //                    prompt = green + taskcontext->getName() + coloroff + "[" + state + "]> ";
                     prompt = taskcontext->getName() + " [" + state + "]> ";
+                    if ( batching ) {
+                        stringstream bp;
+                        bp << taskcontext->getName() << " [" << state << "] batch(" << batchcalls.size() << ")> ";
+                        prompt = bp.str();
+                    }
                     // This 'endl' is important because it flushes the whole output to screen of all
                     // processing that previously happened, which was using 'nl'.
                     cout.flush();
@@ -883,6 +913,7 @@ namespace OCL
                 }
                 // Check port status:
                 checkPorts();
+                checkTraces();
                 std::string command;
                 // When using rxvt on windows, the process will receive signals when the arrow keys are used
                 // during input. We compile with /EHa to catch these signals and don't print anything.
@@ -904,6 +935,10 @@ namespace OCL
                 }
                 str_trim( command, ' ');
                 cout << coloroff;
+#ifdef USE_READLINE
+                // don't let the completion index query components while we do.
+                CompletionIndex::Pause pause( cindex );
+#endif
                 if ( command == "quit" ) {
                     // Intercept no Ctrl-C
                     cout << endl;
@@ -924,6 +959,8 @@ namespace OCL
                     browserAction(command);
                 } else if ( command.find("untrace ") == 0 || command == "untrace" ) {
                     browserAction(command);
+                } else if ( command.find("top ") == 0 || command == "top" ) {
+                    browserAction(command);
                 } else if ( command.find("ls") == 0 ) {
                     std::string::size_type pos = command.find("ls")+2;
                     command = std::string(command, pos, command.length());
@@ -947,12 +984,17 @@ namespace OCL
                     macrotext += command +'\n';
                 } else {
                     try {
-                        this->evalCommand( command );
+                        if ( !batching || !this->sendCommand( command ) )
+                            this->evalCommand( command );
                     } catch(std::exception& e) {
                         cerr << "The command '"<<command<<"' caused a std::exception: '"<< e.what()<<"' and could not be completed."<<endl;
                     } catch(...){
                         cerr << "The command '"<<command<<"' caused an unknown exception and could not be completed."<<endl;
                     }
+#ifdef USE_READLINE
+                    // it may have loaded components or added peers.
+                    cindex->invalidate( commandPath( command ) );
+#endif
                     // a command was typed... clear storedline such that a next 'list'
                     // shows the 'IP' again.
                     storedline = -1;
@@ -973,6 +1015,9 @@ namespace OCL
             return;
         }
         context = taskcontext;
+#ifdef USE_READLINE
+        cindex->setRoot( context );
+#endif
         log(Info) <<"Entering Task "<< taskcontext->getName()<<endlog();
     }
 
@@ -983,6 +1028,9 @@ namespace OCL
             return;
         }
         context = tb;
+#ifdef USE_READLINE
+        cindex->setRoot( context );
+#endif
         log(Info) <<"Watching Task "<< taskcontext->getName()<<endlog();
     }
 
@@ -1065,6 +1113,56 @@ namespace OCL
         }
     }
 
+    void TaskBrowser::tracePort(const std::string& name, const std::string& file, unsigned int samples, double seconds)
+    {
+        if ( tracers.count( name ) ) {
+            cerr << "Already tracing " << name << ", use 'untrace " << name << "' first." <<endl;
+            return;
+        }
+        peer = context;
+        taskobject = context->provides();
+        std::string::size_type dot = name.rfind('.');
+        if ( dot != std::string::npos && this->findPeer( name.substr(0, dot) + "." ) == 0 ) {
+            cerr << "No such peer or service: " << name.substr(0, dot) <<endl;
+            return;
+        }
+        OutputPortInterface* port = dynamic_cast<OutputPortInterface*>(
+                taskobject->getPort( dot == std::string::npos ? name : name.substr(dot + 1) ) );
+        if ( !port ) {
+            cerr << "No such output port: " << name <<endl;
+            return;
+        }
+        PortTracer* tracer = new PortTracer( port, name );
+        if ( !tracer->start( file, samples, seconds ) ) {
+            cerr << "Could not trace " << name << " to " << file <<endl;
+            delete tracer;
+            return;
+        }
+        tracers[name] = tracer;
+        cout << "Tracing " << name << " to " << file;
+        if ( samples )
+            cout << " for " << samples << " samples";
+        if ( seconds > 0.0 )
+            cout << (samples ? " or " : " for ") << seconds << " seconds";
+        cout << ", use 'untrace " << name << "' to stop." <<endl;
+    }
+
+    void TaskBrowser::checkTraces()
+    {
+        PortTraces::iterator it = tracers.begin();
+        while ( it != tracers.end() ) {
+            if ( it->second->isTracing() ) {
+                ++it;
+                continue;
+            }
+            it->second->stop();
+            cout << "Finished tracing " << it->first << ", wrote " << it->second->samples()
+                 << " samples to " << it->second->getFile() <<endl;
+            delete it->second;
+            tracers.erase( it++ );
+        }
+    }
+
     void TaskBrowser::setColorTheme(ColorTheme t)
     {
         // background color palettes:
@@ -1171,6 +1269,11 @@ namespace OCL
         }
         RTT::connectPorts(this,taskcontext);
 
+#ifdef USE_READLINE
+        // is null while constructing.
+        if ( cindex )
+            cindex->setRoot( context );
+#endif
 
 
         cerr << "   Switched to : " << taskcontext->getName() <<endl;
@@ -1241,6 +1344,19 @@ namespace OCL
         // TRACING
         //
         if ( instr == "trace") {
+            // trace <port> <file> [samples] [seconds] :
+            std::stringstream ts(act);
+            string port, file;
+            ts >> instr >> port >> file;
+            if (ts) {
+                unsigned int samples = 0;
+                double seconds = 0.0;
+                if ( ts >> samples )
+                    ts >> seconds;
+                this->tracePort( port, file, samples, seconds );
+                return;
+            }
+
             if (context->provides()->hasService("scripting") == false) {
                 log(Error)<< "Can not trace a program in a TaskContext without scripting service." <<endlog();
                 return;
@@ -1286,6 +1402,19 @@ namespace OCL
         }
 
         if ( instr == "untrace") {
+            std::stringstream ts(act);
+            string port;
+            ts >> instr >> port;
+            PortTraces::iterator pt = tracers.find( port );
+            if ( pt != tracers.end() ) {
+                pt->second->stop();
+                cout << "Stopped tracing " << port << ", wrote " << pt->second->samples()
+                     << " samples to " << pt->second->getFile() <<endl;
+                delete pt->second;
+                tracers.erase( pt );
+                return;
+            }
+
             if (context->provides()->hasService("scripting") == false) {
                 log(Error)<< "Can not untrace a program in a TaskContext without scripting service." <<endlog();
                 return;
@@ -1318,6 +1447,28 @@ namespace OCL
             return;
         }
 
+        //
+        // MONITORING
+        //
+        if ( instr == "top") {
+            double period = 1.0;
+            ss >> period;
+            if ( !ss ) {
+                period = 1.0;
+                ss.clear();
+            }
+            if ( period < 0.01 ) {
+                cerr << "top: the period must be at least 0.01 seconds." <<endl;
+                return;
+            }
+            std::vector<std::string> items;
+            string arg;
+            while ( ss >> arg )
+                items.push_back( arg );
+            this->monitor( period, items );
+            return;
+        }
+
         std::string arg;
         ss >> arg;
         if ( instr == "dark") {
@@ -1386,6 +1537,48 @@ namespace OCL
             cout <<endl;
             return;
         }
+        if (instr == "batch") {
+            if ( batching ) {
+                cerr << "Already in batch mode, use '.collect' to leave it." <<endl;
+                return;
+            }
+            if ( ss ) {
+                double timeout = default_collect_timeout;
+                std::string t;
+                if ( ss >> t )
+                    timeout = atof( t.c_str() );
+                this->runBatch( arg, timeout );
+                return;
+            }
+            batching = true;
+            cout << "Batch mode: operation calls are sent without waiting for their results."<<nl
+                 << "Use '.collect [timeout]' to wait for all of them and list their results." <<endl;
+            return;
+        }
+        if (instr == "collect") {
+            if ( !batching ) {
+                cerr << "Not in batch mode, use '.batch' first." <<endl;
+                return;
+            }
+            double timeout = default_collect_timeout;
+            if ( ss )
+                timeout = atof( arg.c_str() );
+            this->collectBatch( timeout );
+            return;
+        }
+        if (instr == "exportTrace") {
+            string table;
+            ss >> table;
+            if ( !ss ) {
+                cerr << "Usage: .exportTrace <trace-file> <table-file>" <<endl;
+                return;
+            }
+            if ( PortTracer::exportTable( arg, table ) )
+                cout << "Exported " << arg << " to " << table <<endl;
+            else
+                cerr << "Could not export " << arg << " to " << table <<endl;
+            return;
+        }
         if (instr == "types") {
             vector<string> names = TypeInfoRepository::Instance()->getDottedTypes();
             cout << "Available data types: ";
@@ -1399,6 +1592,251 @@ namespace OCL
         cerr << "See 'help' for valid syntax."<<endl;
     }
 
+    /**
+     * A line of the 'top' monitor: a component and its state or
+     * a cached data source and its value.
+     */
+    struct MonitorRow
+    {
+        std::string name;
+        RTT::TaskContext* task;
+        base::DataSourceBase::shared_ptr ds;
+        std::string kind;       // 'A'ttribute, 'P'roperty or 'O'utput port
+        std::string rate;       // the nominal rate of a component
+        DataSource<unsigned int>::shared_ptr cycles; // of its timing service
+        std::string cells[3];   // status, rate and value as last drawn
+        unsigned int changes;   // value changes in the current rate window, or the cycle count at its start
+        MonitorRow() : task(0), changes(0) {}
+    };
+
+    // one remote call per sample, unlike getTaskStatusChar().
+    static void getTaskStateCells(RTT::TaskContext* t, std::string& status, std::string& name)
+    {
+        switch ( t->getTaskState() ) {
+        case TaskContext::Init:           status = "U"; name = "Init"; break;
+        case TaskContext::PreOperational: status = "U"; name = "PreOperational"; break;
+        case TaskContext::FatalError:     status = "F"; name = "FatalError"; break;
+        case TaskContext::Exception:      status = "X"; name = "Exception"; break;
+        case TaskContext::Stopped:        status = "S"; name = "Stopped"; break;
+        case TaskContext::Running:        status = "R"; name = "Running"; break;
+        case TaskContext::RunTimeError:   status = "E"; name = "RunTimeError"; break;
+        default:                       status = "?"; name = "Unknown"; break;
+        }
+    }
+
+#ifndef _WIN32
+    // column and width of the name, status, rate and value cells, 0 is up to the end of the line.
+    static const int monitor_col[] = { 1, 33, 37, 49 };
+    static const int monitor_width[] = { 32, 4, 12, 0 };
+
+    static void drawCell(int row, int col, const std::string& text)
+    {
+        cout << "\033[" << row << ';' << monitor_col[col] << 'H';
+        if ( monitor_width[col] )
+            cout << setw( monitor_width[col] ) << left << text.substr(0, monitor_width[col] - 1) << right;
+        else
+            cout << text.substr(0, 80) << "\033[K";
+    }
+
+    /**
+     * Puts the terminal in raw mode without echo while in scope.
+     */
+    class RawTerminal
+    {
+        struct termios saved;
+        bool active;
+    public:
+        RawTerminal(bool enable = true)
+            : active(enable)
+        {
+            if ( !active )
+                return;
+            struct termios raw;
+            tcgetattr(STDIN_FILENO, &saved);
+            raw = saved;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            raw.c_cc[VMIN] = 1;
+            raw.c_cc[VTIME] = 0;
+            tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        }
+        ~RawTerminal()
+        {
+            if ( active )
+                tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        }
+    };
+#endif
+
+    void TaskBrowser::monitor(double period, const std::vector<std::string>& items)
+    {
+#ifndef _WIN32
+        if ( !isatty(STDIN_FILENO) ) {
+            cerr << "top: needs a terminal." <<endl;
+            return;
+        }
+
+        // resolve all data sources once, sampling only evaluates them.
+        std::vector<MonitorRow> rows;
+        if ( items.empty() ) {
+            MonitorRow r;
+            r.name = context->getName();
+            r.task = context;
+            rows.push_back( r );
+            RTT::TaskContext::PeerList v = context->getPeerList();
+            for (RTT::TaskContext::PeerList::iterator i = v.begin(); i != v.end(); ++i) {
+                r.name = *i;
+                r.task = context->getPeer( *i );
+                if ( r.task )
+                    rows.push_back( r );
+            }
+        }
+        for (std::vector<std::string>::const_iterator it = items.begin(); it != items.end(); ++it) {
+            MonitorRow r;
+            r.name = *it;
+            std::string::size_type dot = it->rfind('.');
+            std::string item = it->substr( dot == std::string::npos ? 0 : dot + 1 );
+            peer = context;
+            taskobject = context->provides();
+            if ( dot != std::string::npos && this->findPeer( it->substr(0, dot) + "." ) == 0 ) {
+                cerr << "top: no such peer or service: " << it->substr(0, dot) <<endl;
+                return;
+            }
+            base::PortInterface* port = 0;
+            if ( taskobject == peer->provides() && peer->hasPeer( item ) ) {
+                r.task = peer->getPeer( item );
+            } else if ( taskobject->hasAttribute( item ) ) {
+                r.ds = taskobject->getValue( item )->getDataSource();
+                r.kind = "A";
+            } else if ( taskobject->properties()->getProperty( item ) ) {
+                r.ds = taskobject->properties()->getProperty( item )->getDataSource();
+                r.kind = "P";
+            } else if ( (port = taskobject->getPort( item )) && dynamic_cast<OutputPortInterface*>(port) ) {
+                OutputPortInterface* oport = dynamic_cast<OutputPortInterface*>(port);
+                if ( !oport->keepsLastWrittenValue() ) {
+                    cerr << "top: port " << *it << " does not keep its last written value." <<endl;
+                    return;
+                }
+                r.ds = oport->getDataSource();
+                r.kind = "O";
+            } else {
+                cerr << "top: " << *it << " is not a peer, attribute, property or output port." <<endl;
+                return;
+            }
+            rows.push_back( r );
+        }
+        for (std::vector<MonitorRow>::iterator r = rows.begin(); r != rows.end(); ++r) {
+            if ( !r->task )
+                continue;
+            // the timing service counts the cycles, which gives the actual rate.
+            if ( r->task->provides()->hasService("timing") ) {
+                Property<unsigned int>* c = r->task->provides("timing")->properties()->getPropertyType<unsigned int>("Cycles");
+                if ( c ) {
+                    r->cycles = c->getDataSource();
+                    r->changes = r->cycles->get();
+                    continue;
+                }
+            }
+            base::ActivityInterface* act = r->task->getActivity();
+            stringstream rs;
+            if ( !act )
+                rs << "-";
+            else if ( act->getPeriod() == 0.0 )
+                rs << "event";
+            else
+                rs << 1.0 / act->getPeriod() << " Hz nom";
+            r->rate = rs.str();
+        }
+
+        // any key stops, without waiting for enter. Restored when
+        // leaving, also if a peer throws while sampling.
+        RawTerminal raw;
+
+        cout << "\033[2J\033[1;1H" << coloron << " Monitoring " << context->getName()
+             << " every " << period << "s, press any key to stop." << coloroff;
+        drawCell(3, 0, "Name");
+        drawCell(3, 1, "S");
+        drawCell(3, 2, "Rate");
+        drawCell(3, 3, "Value");
+        for (unsigned int i = 0; i != rows.size(); ++i)
+            drawCell(4 + i, 0, rows[i].name);
+
+        os::TimeService* ts = os::TimeService::Instance();
+        os::TimeService::ticks window = ts->getTicks();
+        unsigned int samples = 0;
+        bool quit = false;
+        while ( !quit ) {
+            os::TimeService::ticks start = ts->getTicks();
+            double elapsed = ts->secondsSince( window );
+            bool newwindow = elapsed >= 1.0;
+            for (unsigned int i = 0; i != rows.size(); ++i) {
+                MonitorRow& r = rows[i];
+                std::string cells[3];
+                if ( r.task ) {
+                    getTaskStateCells( r.task, cells[0], cells[2] );
+                    cells[1] = r.cycles ? r.cells[1] : r.rate;
+                    if ( r.cycles && newwindow ) {
+                        unsigned int cycles = r.cycles->get();
+                        stringstream rs;
+                        rs << std::fixed << setprecision(1) << (cycles - r.changes) / elapsed << " Hz";
+                        cells[1] = rs.str();
+                        r.changes = cycles;
+                    }
+                } else {
+                    r.ds->evaluate();
+                    stringstream vs;
+                    if (usehex)
+                        vs << std::hex << r.ds;
+                    else
+                        vs << std::dec << r.ds;
+                    cells[0] = r.kind;
+                    cells[2] = vs.str();
+                    if ( samples && cells[2] != r.cells[2] )
+                        ++r.changes;
+                    cells[1] = r.cells[1];
+                    if ( newwindow ) {
+                        stringstream rs;
+                        rs << std::fixed << setprecision(1) << r.changes / elapsed << " Hz";
+                        cells[1] = rs.str();
+                        r.changes = 0;
+                    }
+                }
+                // only redraw what changed.
+                for (unsigned int c = 0; c != 3; ++c)
+                    if ( cells[c] != r.cells[c] ) {
+                        drawCell(4 + i, c + 1, cells[c]);
+                        r.cells[c] = cells[c];
+                    }
+            }
+            if ( newwindow )
+                window = ts->getTicks();
+            ++samples;
+            stringstream fs;
+            fs << " " << samples << " samples, the last one took "
+               << (long)(ts->secondsSince( start ) * 1e6) << " us.";
+            cout << "\033[" << 5 + rows.size() << ";1H" << fs.str() << "\033[K";
+            cout.flush();
+
+            // wait for the next sample or a key press.
+            double wait = period - ts->secondsSince( start );
+            if ( wait < 0.0 )
+                wait = 0.0;
+            struct timeval tv;
+            tv.tv_sec = (long) wait;
+            tv.tv_usec = (long) ((wait - tv.tv_sec) * 1e6);
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(STDIN_FILENO, &fds);
+            if ( select(STDIN_FILENO + 1, &fds, 0, 0, &tv) > 0 ) {
+                char c;
+                quit = ::read(STDIN_FILENO, &c, 1) >= 0;
+            }
+        }
+        cout << "\033[" << 6 + rows.size() << ";1H" <<endl;
+#else
+        cerr << "top: not supported on this platform." <<endl;
+#endif
+    }
+
     void TaskBrowser::evaluate(std::string& comm) {
         this->evalCommand(comm);
     }
@@ -1712,6 +2150,211 @@ namespace OCL
         }
     }
 
+    /**
+     * Splits the argument list of a call at the commas which are not
+     * nested in brackets or quotes. Returns false if the brackets
+     * do not match, e.g. in "a(1) + b(2)".
+     */
+    static bool splitArguments(const std::string& args, std::vector<std::string>& result)
+    {
+        std::string cur;
+        int depth = 0;
+        bool quoted = false;
+        for (std::string::size_type i = 0; i != args.size(); ++i) {
+            char c = args[i];
+            if ( quoted ) {
+                if ( c == '\\' && i + 1 != args.size() ) {
+                    cur += c;
+                    c = args[++i];
+                } else if ( c == '"' )
+                    quoted = false;
+            } else if ( c == '"' )
+                quoted = true;
+            else if ( c == '(' || c == '[' || c == '{' )
+                ++depth;
+            else if ( c == ')' || c == ']' || c == '}' ) {
+                if ( --depth < 0 )
+                    return false;
+            } else if ( c == ',' && depth == 0 ) {
+                str_trim( cur, ' ' );
+                result.push_back( cur );
+                cur.clear();
+                continue;
+            }
+            cur += c;
+        }
+        str_trim( cur, ' ' );
+        if ( !cur.empty() || !result.empty() )
+            result.push_back( cur );
+        return depth == 0 && !quoted;
+    }
+
+    bool TaskBrowser::sendCommand(const std::string& comm)
+    {
+        // only 'path.operation(args)' is sent, anything else is evaluated.
+        std::string call = comm;
+        if ( !call.empty() && call[ call.size() - 1 ] == ';' )
+            call.erase( call.size() - 1 );
+        str_trim( call, ' ' );
+        std::string::size_type open = call.find('(');
+        if ( open == std::string::npos || call[ call.size() - 1 ] != ')' )
+            return false;
+        std::string name = call.substr(0, open);
+        str_trim( name, ' ' );
+        if ( name.empty() || name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.") != std::string::npos )
+            return false;
+        std::vector<std::string> argtexts;
+        if ( !splitArguments( call.substr(open + 1, call.size() - open - 2), argtexts ) )
+            return false;
+
+        peer = context;
+        taskobject = context->provides();
+        std::string::size_type dot = name.rfind('.');
+        if ( dot != std::string::npos && this->findPeer( name.substr(0, dot) + "." ) == 0 )
+            return false;
+        std::string opname = name.substr( dot == std::string::npos ? 0 : dot + 1 );
+        OperationInterfacePart* part = taskobject->getPart( opname );
+        if ( !part )
+            return false;
+
+        BatchCall bc;
+        bc.command = call;
+        bc.latency = 0.0;
+        bc.status = "pending";
+        try {
+            scripting::Parser parser( GlobalEngine::Instance() );
+            OperationCallerC occ( part, opname, GlobalEngine::Instance() );
+            for (std::vector<std::string>::iterator it = argtexts.begin(); it != argtexts.end(); ++it)
+                occ.arg( parser.parseExpression( *it, context ) );
+            bc.sent = os::TimeService::Instance()->getTicks();
+            bc.handle = occ.send();
+            for (unsigned int i = 1; i <= part->collectArity(); ++i) {
+                DataSourceBase::shared_ptr result = part->getCollectType(i)->buildValue();
+                bc.results.push_back( result );
+                bc.handle.arg( result );
+            }
+        } catch ( parse_exception& pe ) {
+            bc.status = "error";
+            bc.error = pe.what();
+        } catch ( std::exception& e ) {
+            bc.status = "error";
+            bc.error = e.what();
+        }
+        batchcalls.push_back( bc );
+        return true;
+    }
+
+    void TaskBrowser::collectBatch(double timeout)
+    {
+        os::TimeService* ts = os::TimeService::Instance();
+        os::TimeService::ticks start = ts->getTicks();
+#ifndef _WIN32
+        // any key stops waiting, like in 'top'.
+        bool tty = isatty(STDIN_FILENO);
+        RawTerminal raw( tty );
+#endif
+        // poll all handles, such that the completion times are those of the calls
+        // and not those of the calls collected before them.
+        bool pending = true;
+        while ( pending ) {
+            pending = false;
+            for (std::vector<BatchCall>::iterator it = batchcalls.begin(); it != batchcalls.end(); ++it) {
+                if ( it->status != "pending" )
+                    continue;
+                SendStatus st = it->handle.collectIfDone();
+                if ( st == SendNotReady ) {
+                    pending = true;
+                    continue;
+                }
+                it->latency = ts->secondsSince( it->sent );
+                it->status = st == SendSuccess ? "done" : "failed";
+            }
+            if ( !pending || ( timeout > 0.0 && ts->secondsSince( start ) >= timeout ) )
+                break;
+#ifndef _WIN32
+            if ( tty ) {
+                struct timeval tv;
+                tv.tv_sec = 0;
+                tv.tv_usec = 1000;
+                fd_set fds;
+                FD_ZERO(&fds);
+                FD_SET(STDIN_FILENO, &fds);
+                char c;
+                if ( select(STDIN_FILENO + 1, &fds, 0, 0, &tv) > 0 && ::read(STDIN_FILENO, &c, 1) >= 0 )
+                    break;
+                continue;
+            }
+#endif
+            TIME_SPEC tv;
+            tv.tv_sec = 0;
+            tv.tv_nsec = 1000000;
+            rtos_nanosleep( &tv, 0 );
+        }
+
+        unsigned int done = 0, failed = 0, waiting = 0;
+        double longest = 0.0;
+        cout << nl << coloron << setw(4) << "#" << "  " << setw(40) << left << "Operation"
+             << setw(10) << "Status" << right << setw(10) << "Time [ms]" << "  Result" << coloroff << nl;
+        for (unsigned int i = 0; i != batchcalls.size(); ++i) {
+            BatchCall& bc = batchcalls[i];
+            stringstream result;
+            if ( bc.status == "done" ) {
+                ++done;
+                for (unsigned int r = 0; r != bc.results.size(); ++r)
+                    result << (r ? ", " : "") << bc.results[r];
+            } else if ( bc.status == "pending" )
+                ++waiting;
+            else {
+                ++failed;
+                result << bc.error;
+            }
+            if ( bc.latency > longest )
+                longest = bc.latency;
+            cout << setw(4) << i + 1 << "  " << setw(40) << left << bc.command.substr(0, 39)
+                 << setw(10) << bc.status << right << setw(10);
+            if ( bc.status == "done" || bc.status == "failed" )
+                cout << std::fixed << setprecision(1) << bc.latency * 1e3;
+            else
+                cout << "-";
+            cout << "  " << result.str() << nl;
+        }
+        cout << " " << batchcalls.size() << " calls: " << done << " done, " << failed << " failed, "
+             << waiting << " pending, the slowest took " << longest * 1e3 << " ms." <<endl;
+        cout.unsetf( ios::floatfield );
+        cout << setprecision(6);
+        batchcalls.clear();
+        batching = false;
+    }
+
+    void TaskBrowser::runBatch(const std::string& file, double timeout)
+    {
+        ifstream in( file.c_str() );
+        if ( !in ) {
+            cerr << "Could not open batch file " << file <<endl;
+            return;
+        }
+        batching = true;
+        std::string line;
+        while ( getline( in, line ) ) {
+            str_trim( line, ' ' );
+            if ( line.empty() || line[0] == '#' || line.find("//") == 0 )
+                continue;
+            try {
+                if ( line[0] == '.' ) {
+                    // a '.collect' collects the calls sent so far, the batch goes on.
+                    this->browserAction( line.substr(1) );
+                    batching = true;
+                } else if ( !this->sendCommand( line ) )
+                    this->evalCommand( line );
+            } catch(std::exception& e) {
+                cerr << "The command '"<<line<<"' caused a std::exception: '"<< e.what()<<"'."<<endl;
+            } catch(...) {
+                cerr << "The command '"<<line<<"' caused an unknown exception."<<endl;
+            }
+        }
+        this->collectBatch( timeout );
+    }
+
     void TaskBrowser::printResult( base::DataSourceBase* ds, bool recurse) {
         std::string prompt(" = ");
         // setup prompt :
@@ -1926,11 +2569,24 @@ namespace OCL
         cout << "   each time the line number of the traced program changes."<<nl;
         cout << "   Disable tracing with "<<comcol("untrace [progname]")<<""<<nl;
         cout << "   If no arguments are given to "<<comcol("trace")<<" and "<<comcol("untrace")<<", it applies to all programs."<<nl;
+        cout << "  To record the samples of an output port, use "<<comcol("trace <port> <file> [samples] [seconds]")<<nl;
+        cout << "   which writes every sample with a time stamp to a binary file in the background,"<<nl;
+        cout << "   until [samples] samples or [seconds] seconds are written or "<<comcol("untrace <port>")<<" is typed."<<nl;
+        cout << "   Use "<<comcol(".exportTrace <file> <table-file>")<<" to convert it to the ReportingComponent table format."<<nl;
 
         cout << "   A status character shows which line is being executed."<<nl;
         cout << "   For programs : 'E':Error, 'S':Stopped, 'R':Running, 'P':Paused"<<nl;
         cout << "   For state machines : <the same as programs> + 'A':Active, 'I':Inactive"<<nl;
 
+        cout <<titlecol("Monitoring")<<nl;
+        cout << "  To watch components, use "<<comcol("top [period] [item ...]")<<" which redraws every"<<nl;
+        cout << "   [period] seconds (default 1) the state of each item until a key is pressed."<<nl;
+        cout << "   An item is a peer, or an attribute, property or output port such as 'peer.service.x'."<<nl;
+        cout << "   Without items, the current component and its peers are shown. Values are read"<<nl;
+        cout << "   through data sources looked up once and only changed cells are redrawn, together"<<nl;
+        cout << "   with how often each value changed per second. The rate of a component is measured"<<nl;
+        cout << "   if it has the 'timing' service loaded, otherwise its nominal rate is shown ('nom')."<<nl;
+
         cout <<titlecol("Changing Colors")<<nl;
         cout << "  You can inform the TaskBrowser of your background color by typing "<<comcol(".dark")<<nl;
         cout << "  "<<comcol(".light")<<", or "<<comcol(".nocolors")<<" to increase readability."<<nl;
@@ -1949,6 +2605,14 @@ namespace OCL
         cout << "  While you enter the macro, it is not executed, as you must use scripting syntax which"<<nl;
         cout << "  may use loop or conditional statements, variables etc."<<nl;
 
+        cout <<titlecol("Batch Mode")<<nl;
+        cout << "  After "<<comcol(".batch")<<", each operation call such as 'comp.configure()' is sent"<<nl;
+        cout << "  without waiting for its result, other commands are executed as usual. Type"<<nl;
+        cout << "  "<<comcol(".collect [timeout]")<<" to wait for all sent calls and print their status, time"<<nl;
+        cout << "  and results. It waits at most [timeout] seconds (default 10, 0 is forever) or until a"<<nl;
+        cout << "  key is pressed. "<<comcol(".batch <file> [timeout]")<<" does the same for the commands in a file,"<<nl;
+        cout << "  in which lines starting with '.' are TaskBrowser commands, such as '.collect'."<<nl;
+
         cout <<titlecol("Connecting Ports")<<nl;
         cout << "  You can instruct the TaskBrowser to connect to the ports of the current Peer by"<<nl;
         cout << "  typing "<<comcol(".connect [port-name]")<<", which will temporarily create connections"<<nl;
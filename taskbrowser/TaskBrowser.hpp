@@ -61,6 +61,8 @@
 #include <rtt/RTT.hpp>
 #include <rtt/TaskContext.hpp>
 #include <rtt/Service.hpp>
+#include <rtt/internal/SendHandleC.hpp>
+#include <rtt/os/TimeService.hpp>
 #include <deque>
 #include <string>
 #include <sstream>
@@ -70,6 +72,8 @@
 #endif
 
 #include <ocl/OCL.hpp>
+#include "CompletionIndex.hpp"
+#include "PortTracer.hpp"
 
 namespace OCL
 {
@@ -113,6 +117,23 @@ namespace OCL
         PTrace ptraces;
         PTrace straces;
 
+        // port traces to file, by port path.
+        typedef std::map<std::string, PortTracer*> PortTraces;
+        PortTraces tracers;
+
+        // an operation sent in batch mode, waiting to be collected.
+        struct BatchCall {
+            std::string command;
+            RTT::internal::SendHandleC handle;
+            std::vector<RTT::base::DataSourceBase::shared_ptr> results;
+            RTT::os::TimeService::ticks sent;
+            double latency;         // seconds from send to completion
+            std::string status;     // pending, done, failed or error
+            std::string error;
+        };
+        std::vector<BatchCall> batchcalls;
+        bool batching;
+
         //file to store history
         const char* histfile;
 
@@ -144,6 +165,11 @@ namespace OCL
         static std::string peerpath;
         static std::string text;
 
+        // the peers, services and their members we complete on.
+        static CompletionIndex* cindex;
+        // the node of 'peerpath', found by find_peers().
+        static CompletionIndex::NodePtr cnode;
+
         // helper function
         static char* dupstr( const char *s );
 
@@ -176,6 +202,43 @@ namespace OCL
         void endMacro();
 
         void checkPorts();
+
+        /**
+         * Starts tracing output port \a port to \a file, see PortTracer.
+         */
+        void tracePort(const std::string& port, const std::string& file, unsigned int samples, double seconds);
+
+        /**
+         * Reports and removes the port traces which finished.
+         */
+        void checkTraces();
+
+        /**
+         * Sends \a comm if it is a single operation call, without
+         * waiting for its result, and adds it to the batch. Returns
+         * false if it is no operation call.
+         */
+        bool sendCommand(const std::string& comm);
+
+        /**
+         * Waits at most \a timeout seconds (0 is forever) for all calls
+         * of the batch to complete, or until a key is pressed, prints
+         * their results and leaves batch mode.
+         */
+        void collectBatch(double timeout);
+
+        /**
+         * Executes the commands in \a file in batch mode and collects them.
+         * Lines starting with a '.' are TaskBrowser commands.
+         */
+        void runBatch(const std::string& file, double timeout);
+
+        /**
+         * Redraws the state of components and the values of attributes,
+         * properties and output ports every \a period seconds, until
+         * a key is pressed.
+         */
+        void monitor(double period, const std::vector<std::string>& items);
         Service::shared_ptr stringToService(std::string const& names);
     public:
 
@@ -0,0 +1,70 @@
+#include "LatencyHistogram.hpp"
+
+namespace OCL
+{
+    LatencyHistogram::LatencyHistogram()
+    {
+        reset();
+    }
+
+    void LatencyHistogram::add(long long nsecs)
+    {
+        long long us = nsecs > 0 ? nsecs / 1000 : 0;
+        unsigned int bin = 0;
+        while ( bin < Bins - 1 && us >= (1LL << bin) )
+            ++bin;
+        mbins[bin].inc();
+        mcount.inc();
+
+        int clipped = us < 0x7fffffffLL ? int(us) : 0x7fffffff;
+        int old = mmax_us.read();
+        while ( clipped > old && !mmax_us.cas(old, clipped) )
+            old = mmax_us.read();
+    }
+
+    void LatencyHistogram::reset()
+    {
+        for (unsigned int i = 0; i < Bins; ++i)
+            mbins[i].set(0);
+        mcount.set(0);
+        mmax_us.set(0);
+    }
+
+    unsigned int LatencyHistogram::count() const
+    {
+        return mcount.read();
+    }
+
+    double LatencyHistogram::max() const
+    {
+        return mmax_us.read() * 1e-6;
+    }
+
+    double LatencyHistogram::upperBound(unsigned int i)
+    {
+        return (1LL << i) * 1e-6;
+    }
+
+    double LatencyHistogram::percentile(double p) const
+    {
+        unsigned int n = 0, total = 0;
+        for (unsigned int i = 0; i < Bins; ++i)
+            total += mbins[i].read();
+        if ( total == 0 )
+            return 0.0;
+        for (unsigned int i = 0; i < Bins; ++i) {
+            n += mbins[i].read();
+            // the bound is not above the maximum, also in the open ended last bin
+            if ( n * 100.0 >= p * total )
+                return (i == Bins - 1 || upperBound(i) > max()) ? max() : upperBound(i);
+        }
+        return max();
+    }
+
+    void LatencyHistogram::get(std::vector<double>& bins) const
+    {
+        bins.resize(Bins);
+        for (unsigned int i = 0; i < Bins; ++i)
+            bins[i] = mbins[i].read();
+    }
+}
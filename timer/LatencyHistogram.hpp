@@ -0,0 +1,62 @@
+#ifndef ORO_LATENCY_HISTOGRAM_HPP
+#define ORO_LATENCY_HISTOGRAM_HPP
+
+#include <vector>
+#include <rtt/os/Atomic.hpp>
+
+namespace OCL
+{
+    /**
+     * @brief A lock-free histogram of latencies.
+     *
+     * Bin 0 counts latencies below one microsecond, bin i those below
+     * 2^i microseconds and the last bin all longer ones. add() may be
+     * called concurrently from several threads and never blocks or
+     * allocates. Readers get a consistent enough snapshot for
+     * statistics, not an atomic one.
+     */
+    class LatencyHistogram
+    {
+    public:
+        enum { Bins = 24 };
+
+        LatencyHistogram();
+
+        /**
+         * Adds a latency in nanoseconds. Negative values count as zero.
+         */
+        void add(long long nsecs);
+
+        void reset();
+
+        unsigned int count() const;
+
+        /**
+         * The largest added latency in seconds, with microsecond resolution.
+         */
+        double max() const;
+
+        /**
+         * The upper bound, in seconds, of the bin which contains
+         * the \a p th percentile (0 < p <= 100), limited to max().
+         */
+        double percentile(double p) const;
+
+        /**
+         * Copies the bin counts into \a bins, resizing it to Bins.
+         */
+        void get(std::vector<double>& bins) const;
+
+        /**
+         * The upper bound of bin \a i in seconds.
+         */
+        static double upperBound(unsigned int i);
+
+    private:
+        RTT::os::AtomicInt mbins[Bins];
+        RTT::os::AtomicInt mcount;
+        RTT::os::AtomicInt mmax_us;
+    };
+}
+
+#endif
@@ -14,6 +14,7 @@ namespace OCL
     TimerComponent::TimerComponent( std::string name /*= "os::Timer" */ )
         : TaskContext( name, PreOperational ), port_timers(32), mtimeoutEvent("timeout"),
           mtimer( port_timers, mtimeoutEvent, name ),
+          mmax_dynamic(4096), mslack(0.0), mtimeoutBatch("timeouts"), mengine( mtimeoutBatch, name ),
           waitForCommand( "waitFor", &TimerComponent::waitFor, this), //, &TimerComponent::isTimerExpired, this),
           waitCommand( "wait", &TimerComponent::wait, this) //&TimerComponent::isTimerExpired, this)
     {
@@ -29,6 +30,26 @@ namespace OCL
         this->addOperation( waitForCommand ).doc("Wait until a timer expires.").arg("timerId", "A numeric id of the timer to wait for.");
         this->addOperation( waitCommand ).doc("Arm and wait until that timer expires.").arg("timerId", "A numeric id of the timer to arm and to wait for.").arg("delay", "The delay in seconds before the timer expires.");
         this->addPort(mtimeoutEvent).doc("This port is written each time ANY timer expires. The timer id is the value sent in this port. This port is for backwards compatibility only. It is advised to use the timer_* ports.");
+
+        this->addProperty("MaxDynamicTimers", mmax_dynamic).doc("The number of dynamically allocated timers. Applied in configureHook.");
+        this->addProperty("TimerSlack", mslack).doc("Dynamic timers which expire within this many seconds of each other are delivered in one batch. Applied in configureHook.");
+        this->addOperation("allocateTimer", &TimerEngine::allocate, &mengine, RTT::ClientThread).doc("Allocate a dynamic timer. Returns its id, or -1 if all MaxDynamicTimers timers are in use.");
+        this->addOperation("releaseTimer", &TimerEngine::release, &mengine, RTT::ClientThread).doc("Cancel a dynamic timer and return its id to the free ids.").arg("timerId", "An id returned by allocateTimer.");
+        this->addOperation("armTimer", &TimerEngine::arm, &mengine, RTT::ClientThread).doc("Arm a dynamic timer. Re-arms it if it is armed already.").arg("timerId", "An id returned by allocateTimer.").arg("delay", "The delay in seconds before it fires.");
+        this->addOperation("armTimerAt", &TimerEngine::armAt, &mengine, RTT::ClientThread).doc("Arm a dynamic timer to expire at an absolute time.").arg("timerId", "An id returned by allocateTimer.").arg("time", "The expiry time in seconds, see getTimerTime.");
+        this->addOperation("startPeriodicTimer", &TimerEngine::startPeriodic, &mengine, RTT::ClientThread).doc("Start a dynamic periodic timer. It is re-armed by the timer thread at start + k * period, so it does not drift.").arg("timerId", "An id returned by allocateTimer.").arg("period", "The period in seconds.");
+        this->addOperation("startPeriodicTimerAt", &TimerEngine::startPeriodicAt, &mengine, RTT::ClientThread).doc("Start a dynamic periodic timer which first expires at an absolute time.").arg("timerId", "An id returned by allocateTimer.").arg("start", "The first expiry time in seconds, see getTimerTime.").arg("period", "The period in seconds.");
+        this->addOperation("getTimerTime", &TimerEngine::time, RTT::ClientThread).doc("The current time in seconds of the clock used by the dynamic timers.");
+        this->addOperation("waitForTimer", &TimerEngine::waitFor, &mengine, RTT::ClientThread).doc("Wait in the calling thread until a dynamic timer expires. Returns false if it is not armed or gets cancelled.").arg("timerId", "An id returned by allocateTimer.");
+        this->addOperation("cancelTimer", &TimerEngine::cancel, &mengine, RTT::ClientThread).doc("Disarm a dynamic timer. Returns false if it was not armed.").arg("timerId", "An id returned by allocateTimer.");
+        this->addOperation("isTimerArmed", &TimerEngine::isArmed, &mengine, RTT::ClientThread).doc("Check if a dynamic timer is armed.").arg("timerId", "An id returned by allocateTimer.");
+        addLatencyProperties("Lateness", mlateness, "from the requested expiry until the timer thread handled a dynamic timer");
+        addLatencyProperties("Delivery", mdelivery, "of writing a batch of expired dynamic timers to the timeouts port");
+        addLatencyProperties("Wakeup", mwakeup, "from the handling of a dynamic timer until waitForTimer returned");
+        this->addOperation("updateStatistics", &TimerComponent::updateStatistics, this, RTT::ClientThread).doc("Copy the latency histograms of the dynamic timers into the *Histogram, *P50, *P99 and *Max properties.");
+        this->addOperation("resetStatistics", &TimerComponent::resetStatistics, this, RTT::ClientThread).doc("Clear the latency histograms of the dynamic timers.");
+        this->addPort(mtimeoutBatch).doc("This port is written once for each wake-up of the dynamic timers, with the ids of all dynamic timers which expired.");
+
         for(unsigned int i=0;i<port_timers.size();i++){
             ostringstream port_name;
             port_name<<"timer_"<<i;
@@ -39,13 +60,60 @@ namespace OCL
 
     TimerComponent::~TimerComponent() {
         this->stop();
+        mengine.getActivity()->stop();
         for(unsigned int i=0;i<port_timers.size();i++)
             delete port_timers[i];
     }
 
+    void TimerComponent::LatencyStats::update(const LatencyHistogram& h)
+    {
+        h.get(histogram);
+        p50 = h.percentile(50.0);
+        p99 = h.percentile(99.0);
+        max = h.max();
+    }
+
+    void TimerComponent::addLatencyProperties(const std::string& name, LatencyStats& stats, const std::string& what)
+    {
+        stats.histogram.resize(LatencyHistogram::Bins, 0.0);
+        this->addProperty(name + "Histogram", stats.histogram).doc("Counts of the time " + what + ". Bin 0 counts times below 1us, bin i below 2^i us. Updated by updateStatistics.");
+        this->addProperty(name + "P50", stats.p50).doc("Median time " + what + ", in seconds.");
+        this->addProperty(name + "P99", stats.p99).doc("99th percentile of the time " + what + ", in seconds.");
+        this->addProperty(name + "Max", stats.max).doc("Longest time " + what + ", in seconds.");
+    }
+
+    void TimerComponent::updateStatistics()
+    {
+        mlateness.update( mengine.lateness() );
+        mdelivery.update( mengine.delivery() );
+        mwakeup.update( mengine.wakeup() );
+    }
+
+    void TimerComponent::resetStatistics()
+    {
+        mengine.resetStatistics();
+        updateStatistics();
+    }
+
+    bool TimerComponent::configureHook()
+    {
+        if ( !mengine.setMaxTimers(mmax_dynamic) )
+            return false;
+        mengine.setSlack(mslack);
+        // a full batch can be written without allocating
+        mtimeoutBatch.setDataSample( std::vector<TimerEngine::TimerId>(mmax_dynamic, -1) );
+        return true;
+    }
+
     bool TimerComponent::startHook()
     {
-        return mtimer.getThread() && mtimer.getThread()->start();
+        if ( !mtimer.getThread() || !mtimer.getThread()->start() )
+            return false;
+        if ( !mengine.getActivity()->start() ) {
+            mtimer.getThread()->stop();
+            return false;
+        }
+        return true;
     }
 
     void TimerComponent::updateHook()
@@ -56,6 +124,7 @@ namespace OCL
     void TimerComponent::stopHook()
     {
         mtimer.getThread()->stop();
+        mengine.getActivity()->stop();
     }
 
     bool TimerComponent::wait(RTT::os::Timer::TimerId id, double seconds)
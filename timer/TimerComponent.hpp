@@ -6,6 +6,7 @@
 #include <rtt/TaskContext.hpp>
 #include <rtt/os/Timer.hpp>
 #include <rtt/OutputPort.hpp>
+#include "TimerEngine.hpp"
 
 #include <rtt/RTT.hpp>
 #include <ocl/OCL.hpp>
@@ -39,10 +40,47 @@ namespace OCL
             }
         };
 
+        /**
+         * Helper class for the dynamically allocated timers: writes
+         * each batch of expired timers to one port.
+         */
+        struct BatchCatcher : public TimerEngine {
+            RTT::OutputPort<std::vector<TimerEngine::TimerId> >& me;
+            BatchCatcher(RTT::OutputPort<std::vector<TimerEngine::TimerId> >& op, const std::string& name) :
+                TimerEngine(ORO_SCHED_RT, os::HighestPriority, name + ".TimerEngine"),
+                me(op)
+            {}
+            virtual void expired(const std::vector<TimerEngine::TimerId>& ids) {
+                me.write(ids);
+            }
+        };
+
         std::vector<OutputPort<RTT::os::Timer::TimerId>* > port_timers;
         OutputPort<RTT::os::Timer::TimerId> mtimeoutEvent;
         TimeoutCatcher mtimer;
 
+        unsigned int mmax_dynamic;
+        double mslack;
+
+        /**
+         * Property values of one latency histogram of the dynamic timers.
+         */
+        struct LatencyStats {
+            std::vector<double> histogram;
+            double p50, p99, max;
+            LatencyStats() : p50(0.0), p99(0.0), max(0.0) {}
+            void update(const LatencyHistogram& h);
+        };
+        LatencyStats mlateness, mdelivery, mwakeup;
+        void addLatencyProperties(const std::string& name, LatencyStats& stats, const std::string& what);
+        OutputPort<std::vector<TimerEngine::TimerId> > mtimeoutBatch;
+        BatchCatcher mengine;
+
+        /**
+         * Reserves the dynamic timers.
+         */
+        bool configureHook();
+
         /**
          * This hook will check if a Activity has been properly
          * setup.
@@ -71,6 +109,16 @@ namespace OCL
          */
         bool wait(RTT::os::Timer::TimerId id, double seconds);
 
+        /**
+         * Copies the latency histograms of the dynamic timers into the properties.
+         */
+        void updateStatistics();
+
+        /**
+         * Clears the latency histograms of the dynamic timers.
+         */
+        void resetStatistics();
+
         /**
          * Command Condition: return true if \a id expired.
          */
@@ -0,0 +1,470 @@
+#include "TimerEngine.hpp"
+#include <rtt/Activity.hpp>
+#include <rtt/Logger.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/os/TimeService.hpp>
+#include <rtt/os/fosi.h>
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#endif
+
+namespace OCL
+{
+    using namespace RTT;
+
+    TimerEngine::TimerEngine(int scheduler, int priority, const std::string& name)
+        : mfree(-1), mslack(0), mprogrammed(0), mwindow(0), moverruns(0), mact(0), mquit(false), mtimerfd(-1), mwakefd(-1)
+    {
+#if defined(__linux__)
+        mtimerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        mwakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ( mtimerfd < 0 || mwakefd < 0 )
+            log(Error) << "TimerEngine " << name << ": could not create timerfd or eventfd, falling back to polling." << endlog();
+#endif
+        mact = new Activity(scheduler, priority, 0.0, this, name);
+    }
+
+    TimerEngine::~TimerEngine()
+    {
+        mact->stop();
+        delete mact;
+#if defined(__linux__)
+        if ( mtimerfd >= 0 )
+            close(mtimerfd);
+        if ( mwakefd >= 0 )
+            close(mwakefd);
+#endif
+    }
+
+    TimerEngine::nsecs TimerEngine::now()
+    {
+#if defined(__linux__)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return nsecs(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+#else
+        return os::TimeService::Instance()->getNSecs();
+#endif
+    }
+
+    double TimerEngine::time()
+    {
+        return now() * 1e-9;
+    }
+
+    bool TimerEngine::setMaxTimers(unsigned int max)
+    {
+        if ( mact->isActive() ) {
+            log(Error) << "TimerEngine: can not change the number of timers while running." << endlog();
+            return false;
+        }
+        os::MutexLock locker(mlock);
+        mslots.resize(max);
+        mheap.clear();
+        mheap.reserve(max);
+        mbatch.clear();
+        mbatch.reserve(max);
+        for (unsigned int i = 0; i < max; ++i) {
+            mslots[i].expiry = 0;
+            mslots[i].start = 0;
+            mslots[i].period = 0;
+            mslots[i].cycle = 0;
+            mslots[i].fired = 0;
+            mslots[i].heap_pos = -1;
+            mslots[i].next_free = (i + 1 < max) ? int(i + 1) : -1;
+            mslots[i].used = false;
+        }
+        mfree = max ? 0 : -1;
+        moverruns = 0;
+        program();
+        return true;
+    }
+
+    unsigned int TimerEngine::getMaxTimers() const
+    {
+        return mslots.size();
+    }
+
+    bool TimerEngine::valid(TimerId id) const
+    {
+        return id >= 0 && id < int(mslots.size()) && mslots[id].used;
+    }
+
+    TimerEngine::TimerId TimerEngine::allocate()
+    {
+        os::MutexLock locker(mlock);
+        if ( mfree < 0 )
+            return -1;
+        TimerId id = mfree;
+        mfree = mslots[id].next_free;
+        mslots[id].next_free = -1;
+        mslots[id].used = true;
+        return id;
+    }
+
+    bool TimerEngine::release(TimerId id)
+    {
+        os::MutexLock locker(mlock);
+        if ( !valid(id) )
+            return false;
+        heapRemove(id);
+        mcond.broadcast();
+        mslots[id].used = false;
+        mslots[id].next_free = mfree;
+        mfree = id;
+        return true;
+    }
+
+    /* (re)insert id in the heap, must hold mlock */
+    bool TimerEngine::schedule(TimerId id, nsecs expiry, nsecs period)
+    {
+        if ( !valid(id) )
+            return false;
+        heapRemove(id);
+        mslots[id].expiry = expiry;
+        mslots[id].start = expiry;
+        mslots[id].period = period;
+        mslots[id].cycle = 0;
+        heapInsert(id);
+        // Only reprogram for a timer before the programmed window, or one
+        // which extends it within the slack. Postponing the earliest timer
+        // at most causes an early wake-up, after which the loop reprograms.
+        if ( mprogrammed == 0 || expiry < mwindow )
+            program();
+        else if ( expiry > mprogrammed && expiry <= mwindow + mslack )
+            programAt(expiry);
+        return true;
+    }
+
+    bool TimerEngine::arm(TimerId id, double delay)
+    {
+        if ( delay < 0.0 )
+            return false;
+        os::MutexLock locker(mlock);
+        return schedule(id, now() + nsecs(delay * 1e9), 0);
+    }
+
+    bool TimerEngine::armAt(TimerId id, double time)
+    {
+        os::MutexLock locker(mlock);
+        return schedule(id, nsecs(time * 1e9), 0);
+    }
+
+    bool TimerEngine::startPeriodic(TimerId id, double period)
+    {
+        if ( period <= 0.0 )
+            return false;
+        os::MutexLock locker(mlock);
+        return schedule(id, now() + nsecs(period * 1e9), nsecs(period * 1e9));
+    }
+
+    bool TimerEngine::startPeriodicAt(TimerId id, double start, double period)
+    {
+        if ( period <= 0.0 )
+            return false;
+        os::MutexLock locker(mlock);
+        return schedule(id, nsecs(start * 1e9), nsecs(period * 1e9));
+    }
+
+    void TimerEngine::setSlack(double slack)
+    {
+        os::MutexLock locker(mlock);
+        mslack = slack > 0.0 ? nsecs(slack * 1e9) : 0;
+        program();
+    }
+
+    double TimerEngine::getSlack() const
+    {
+        os::MutexLock locker(mlock);
+        return mslack * 1e-9;
+    }
+
+    unsigned int TimerEngine::overruns() const
+    {
+        os::MutexLock locker(mlock);
+        return moverruns;
+    }
+
+    /* re-arm periodic timer id which expired at or before t, must hold mlock */
+    void TimerEngine::rearm(TimerId id, nsecs t)
+    {
+        Slot& s = mslots[id];
+        ++s.cycle;
+        s.expiry = s.start + s.cycle * s.period;
+        if ( s.expiry <= t ) {
+            // skip the periods we missed, keeping the phase
+            long long next = (t - s.start) / s.period + 1;
+            moverruns += next - s.cycle;
+            s.cycle = next;
+            s.expiry = s.start + s.cycle * s.period;
+        }
+        heapInsert(id);
+    }
+
+    bool TimerEngine::cancel(TimerId id)
+    {
+        os::MutexLock locker(mlock);
+        if ( !valid(id) || mslots[id].heap_pos < 0 )
+            return false;
+        heapRemove(id);
+        mslots[id].period = 0;
+        mcond.broadcast();
+        // an early wake-up is harmless, the timerfd is not reprogrammed
+        return true;
+    }
+
+    bool TimerEngine::isArmed(TimerId id) const
+    {
+        os::MutexLock locker(mlock);
+        return valid(id) && mslots[id].heap_pos >= 0;
+    }
+
+    bool TimerEngine::waitFor(TimerId id)
+    {
+        os::MutexLock locker(mlock);
+        // without the timer thread, nothing would ever wake us.
+        if ( !valid(id) || mslots[id].heap_pos < 0 || !mact->isActive() )
+            return false;
+        nsecs fired = mslots[id].fired;
+        while ( valid(id) && mslots[id].fired == fired ) {
+            if ( mslots[id].heap_pos < 0 || mquit || !mact->isActive() )
+                return false;
+            mcond.wait(mlock);
+        }
+        if ( !valid(id) )
+            return false;
+        mwakeup.add( now() - mslots[id].fired );
+        return true;
+    }
+
+    void TimerEngine::resetStatistics()
+    {
+        mlateness.reset();
+        mdelivery.reset();
+        mwakeup.reset();
+    }
+
+    unsigned int TimerEngine::armed() const
+    {
+        os::MutexLock locker(mlock);
+        return mheap.size();
+    }
+
+    void TimerEngine::heapSwap(int a, int b)
+    {
+        TimerId t = mheap[a];
+        mheap[a] = mheap[b];
+        mheap[b] = t;
+        mslots[mheap[a]].heap_pos = a;
+        mslots[mheap[b]].heap_pos = b;
+    }
+
+    void TimerEngine::siftUp(int pos)
+    {
+        while ( pos > 0 ) {
+            int parent = (pos - 1) / 2;
+            if ( mslots[mheap[parent]].expiry <= mslots[mheap[pos]].expiry )
+                break;
+            heapSwap(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void TimerEngine::siftDown(int pos)
+    {
+        int n = mheap.size();
+        while ( true ) {
+            int l = 2 * pos + 1, r = l + 1, min = pos;
+            if ( l < n && mslots[mheap[l]].expiry < mslots[mheap[min]].expiry )
+                min = l;
+            if ( r < n && mslots[mheap[r]].expiry < mslots[mheap[min]].expiry )
+                min = r;
+            if ( min == pos )
+                break;
+            heapSwap(pos, min);
+            pos = min;
+        }
+    }
+
+    void TimerEngine::heapInsert(TimerId id)
+    {
+        mheap.push_back(id);
+        mslots[id].heap_pos = mheap.size() - 1;
+        siftUp(mheap.size() - 1);
+    }
+
+    void TimerEngine::heapRemove(TimerId id)
+    {
+        int pos = mslots[id].heap_pos;
+        if ( pos < 0 )
+            return;
+        int last = mheap.size() - 1;
+        if ( pos != last ) {
+            heapSwap(pos, last);
+            mheap.pop_back();
+            siftDown(pos);
+            siftUp(pos);
+        } else
+            mheap.pop_back();
+        mslots[id].heap_pos = -1;
+    }
+
+    /* latest expiry not after limit in the sub-heap at pos. Only the
+     * timers within the limit are visited. Must hold mlock. */
+    TimerEngine::nsecs TimerEngine::latestWithin(int pos, nsecs limit) const
+    {
+        nsecs latest = -1;
+        if ( pos >= int(mheap.size()) || mslots[mheap[pos]].expiry > limit )
+            return latest;
+        latest = mslots[mheap[pos]].expiry;
+        nsecs l = latestWithin(2 * pos + 1, limit);
+        nsecs r = latestWithin(2 * pos + 2, limit);
+        if ( l > latest )
+            latest = l;
+        if ( r > latest )
+            latest = r;
+        return latest;
+    }
+
+    /* program the timerfd with the earliest expiry. With a slack, it is
+     * postponed to the last expiry within the slack after it, such that
+     * these timers are delivered at once. Must hold mlock. */
+    void TimerEngine::program()
+    {
+        if ( mheap.empty() ) {
+            mwindow = 0;
+            programAt(0);
+            return;
+        }
+        mwindow = mslots[mheap[0]].expiry;
+        nsecs t = mslack != 0 ? latestWithin(0, mwindow + mslack) : mwindow;
+        programAt( t > 0 ? t : 1 ); // zero would disarm
+    }
+
+    /* program the timerfd to expire at t, or disarm it if t is 0.
+     * Must hold mlock. */
+    void TimerEngine::programAt(nsecs t)
+    {
+        mprogrammed = t;
+#if defined(__linux__)
+        if ( mtimerfd < 0 )
+            return;
+        struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+        if ( t != 0 ) {
+            its.it_value.tv_sec = t / 1000000000LL;
+            its.it_value.tv_nsec = t % 1000000000LL;
+        }
+        timerfd_settime(mtimerfd, TFD_TIMER_ABSTIME, &its, 0);
+#endif
+    }
+
+    void TimerEngine::interrupt()
+    {
+#if defined(__linux__)
+        if ( mwakefd >= 0 ) {
+            uint64_t one = 1;
+            if ( write(mwakefd, &one, sizeof(one)) != sizeof(one) )
+                log(Debug) << "TimerEngine: wake-up failed." << endlog();
+        }
+#endif
+    }
+
+    /* wait until the timerfd expires or interrupt() is called */
+    void TimerEngine::sleep()
+    {
+#if defined(__linux__)
+        if ( mtimerfd >= 0 && mwakefd >= 0 ) {
+            struct pollfd fds[2];
+            uint64_t count;
+            ssize_t r = 0;
+            fds[0].fd = mtimerfd;
+            fds[0].events = POLLIN;
+            fds[1].fd = mwakefd;
+            fds[1].events = POLLIN;
+            if ( poll(fds, 2, -1) > 0 ) {
+                // only clears the fds, count is not used
+                if ( fds[0].revents & POLLIN )
+                    r = read(mtimerfd, &count, sizeof(count));
+                if ( fds[1].revents & POLLIN )
+                    r = read(mwakefd, &count, sizeof(count));
+                (void) r;
+            }
+            return;
+        }
+#endif
+        TIME_SPEC ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 1000000;
+        rtos_nanosleep(&ts, 0);
+    }
+
+    bool TimerEngine::initialize()
+    {
+        os::MutexLock locker(mlock);
+        mquit = false;
+        return true;
+    }
+
+    void TimerEngine::step()
+    {
+    }
+
+    void TimerEngine::loop()
+    {
+        while ( true ) {
+            {
+                os::MutexLock locker(mlock);
+                if ( mquit )
+                    break;
+                nsecs t = now();
+                mbatch.clear();
+                while ( !mheap.empty() && mslots[mheap[0]].expiry <= t ) {
+                    TimerId id = mheap[0];
+                    mlateness.add( t - mslots[id].expiry );
+                    mslots[id].fired = t;
+                    heapRemove(id);
+                    mbatch.push_back(id);
+                    if ( mslots[id].period != 0 )
+                        rearm(id, t);
+                }
+                program();
+                if ( !mbatch.empty() )
+                    mcond.broadcast();
+            }
+            // expired() may re-arm timers, so it is called without the lock.
+            if ( !mbatch.empty() ) {
+                nsecs start = now();
+                expired(mbatch);
+                mdelivery.add( now() - start );
+            }
+            {
+                os::MutexLock locker(mlock);
+                if ( mquit )
+                    break;
+            }
+            sleep();
+        }
+    }
+
+    bool TimerEngine::breakLoop()
+    {
+        {
+            os::MutexLock locker(mlock);
+            mquit = true;
+            // release the waitFor() callers
+            mcond.broadcast();
+        }
+        interrupt();
+        return true;
+    }
+
+    void TimerEngine::finalize()
+    {
+    }
+}
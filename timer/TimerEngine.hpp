@@ -0,0 +1,209 @@
+#ifndef ORO_TIMER_ENGINE_HPP
+#define ORO_TIMER_ENGINE_HPP
+
+#include <vector>
+#include <string>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/Condition.hpp>
+#include <rtt/base/RunnableInterface.hpp>
+#include <rtt/base/ActivityInterface.hpp>
+#include "LatencyHistogram.hpp"
+
+namespace OCL
+{
+    /**
+     * @brief A timer thread for large numbers of dynamically allocated timers.
+     *
+     * Armed timers are kept in a binary min-heap indexed by timer id,
+     * so arming and cancelling a timer is O(log n) and allocating or
+     * releasing an id is O(1). On Linux, the thread sleeps on a
+     * timerfd programmed with the earliest expiry time; elsewhere it
+     * sleeps at most one millisecond at a time.
+     *
+     * All timers which expired when the thread wakes up are handed
+     * over in one call to expired(). All storage is reserved by
+     * setMaxTimers(), which must not be called while the thread runs,
+     * so arming and expiring timers does not allocate memory.
+     */
+    class TimerEngine
+        : public RTT::base::RunnableInterface
+    {
+    public:
+        typedef int TimerId;
+        typedef long long nsecs;
+
+        TimerEngine(int scheduler, int priority, const std::string& name);
+        virtual ~TimerEngine();
+
+        /**
+         * Reserves room for \a max timers. Only allowed while the
+         * thread is not running. Releases all timers.
+         */
+        bool setMaxTimers(unsigned int max);
+        unsigned int getMaxTimers() const;
+
+        /**
+         * Returns a free timer id, or -1 if all ids are in use.
+         */
+        TimerId allocate();
+
+        /**
+         * Cancels timer \a id and returns it to the free ids.
+         */
+        bool release(TimerId id);
+
+        /**
+         * Arms timer \a id to expire after \a delay seconds. An armed
+         * timer is re-armed.
+         */
+        bool arm(TimerId id, double delay);
+
+        /**
+         * Arms timer \a id to expire at \a time, in seconds of now().
+         * A time in the past expires at the next wake-up.
+         */
+        bool armAt(TimerId id, double time);
+
+        /**
+         * Starts timer \a id as a periodic timer. It expires at
+         * start + k * period for k = 1, 2, ... and is re-armed by the
+         * timer thread, so it does not drift. Missed periods are
+         * skipped and counted in overruns().
+         */
+        bool startPeriodic(TimerId id, double period);
+
+        /**
+         * Like startPeriodic(), but the first expiry is at \a start,
+         * in seconds of now(), and the next ones at start + k * period.
+         */
+        bool startPeriodicAt(TimerId id, double start, double period);
+
+        /**
+         * Sets the slack in seconds by which an expiry may be delayed,
+         * such that timers expiring within that window are delivered
+         * in one batch. The wake-up is only delayed as far as another
+         * timer expires within the window. Zero delivers every timer
+         * as soon as possible.
+         */
+        void setSlack(double slack);
+        double getSlack() const;
+
+        /**
+         * Number of periods which were skipped because the timer thread
+         * could not keep up.
+         */
+        unsigned int overruns() const;
+
+        /**
+         * Disarms timer \a id. Returns false if it was not armed.
+         */
+        bool cancel(TimerId id);
+
+        bool isArmed(TimerId id) const;
+
+        /**
+         * Blocks the calling thread until timer \a id expires. Returns
+         * false if it is not armed, is cancelled while waiting or if
+         * the timer thread is not running.
+         */
+        bool waitFor(TimerId id);
+
+        /**
+         * Time from the requested expiry until the timer thread
+         * handled the timer.
+         */
+        const LatencyHistogram& lateness() const { return mlateness; }
+
+        /**
+         * Duration of the expired() calls, e.g. the port writes.
+         */
+        const LatencyHistogram& delivery() const { return mdelivery; }
+
+        /**
+         * Time from the handling of the timer until a waitFor() call
+         * waiting for it returned.
+         */
+        const LatencyHistogram& wakeup() const { return mwakeup; }
+
+        void resetStatistics();
+
+        /**
+         * Number of timers currently armed.
+         */
+        unsigned int armed() const;
+
+        /**
+         * The activity running this engine.
+         */
+        RTT::base::ActivityInterface* getActivity() const { return mact; }
+
+        /**
+         * Monotonic time used for the expiry times, in nanoseconds.
+         */
+        static nsecs now();
+
+        /**
+         * now() in seconds.
+         */
+        static double time();
+
+        bool initialize();
+        void step();
+        void loop();
+        bool breakLoop();
+        void finalize();
+
+    protected:
+        /**
+         * Called in the timer thread with all timers which expired
+         * since the previous call. Single shot timers are no longer
+         * armed, periodic timers are already re-armed.
+         */
+        virtual void expired(const std::vector<TimerId>& ids) = 0;
+
+        struct Slot {
+            nsecs expiry;
+            nsecs start;    // first expiry of a periodic timer
+            nsecs period;   // 0 for single shot timers
+            long long cycle;
+            nsecs fired;    // when the last expiry was handled
+            int heap_pos;   // -1 if not armed
+            int next_free;  // next free id, -1 if allocated or last
+            bool used;
+        };
+
+        std::vector<Slot> mslots;
+        std::vector<TimerId> mheap;
+        std::vector<TimerId> mbatch;
+        int mfree;
+        nsecs mslack;
+        nsecs mprogrammed;  // expiry of the timerfd, 0 if disarmed
+        nsecs mwindow;      // earliest expiry when it was programmed
+        unsigned int moverruns;
+        mutable RTT::os::Mutex mlock;
+        RTT::os::Condition mcond;
+        LatencyHistogram mlateness;
+        LatencyHistogram mdelivery;
+        LatencyHistogram mwakeup;
+        RTT::base::ActivityInterface* mact;
+        bool mquit;
+        int mtimerfd;
+        int mwakefd;
+
+        bool valid(TimerId id) const;
+        void heapSwap(int a, int b);
+        void siftUp(int pos);
+        void siftDown(int pos);
+        void heapInsert(TimerId id);
+        void heapRemove(TimerId id);
+        bool schedule(TimerId id, nsecs expiry, nsecs period);
+        void rearm(TimerId id, nsecs t);
+        nsecs latestWithin(int pos, nsecs limit) const;
+        void program();
+        void programAt(nsecs t);
+        void interrupt();
+        void sleep();
+    };
+}
+
+#endif
@@ -68,6 +68,8 @@ int ORO_main( int argc, char** argv)
     cout <<endl<< "  This demo allows testing the TimerComponent." << endl;
     cout << "  Use 'Timer.arm(0, 1.5)' to arm timer '0' to end over 1.5 seconds. " <<endl;
     cout << "  32 timers are initially available (0..31)." <<endl;
+    cout << "  Dynamic timers are allocated with 'Timer.allocateTimer()', armed with" <<endl;
+    cout << "  'Timer.armTimer(id, 1.5)' and reported in batches on the 'timeouts' port." <<endl;
     cout << "  Other methods (type 'this') are available as well."<<endl;
 
     tb.loop();
@@ -0,0 +1,159 @@
+#include <timer/TimerComponent.hpp>
+
+#include <rtt/Activity.hpp>
+#include <rtt/InputPort.hpp>
+#include <rtt/OperationCaller.hpp>
+#include <rtt/os/main.h>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+
+using namespace std;
+using namespace RTT;
+using namespace OCL;
+
+/**
+ * Receives the batches of expired timers and records how late each
+ * timer reached it, relative to its requested expiry time.
+ */
+class TimerConsumer
+    : public RTT::TaskContext
+{
+    InputPort<std::vector<TimerEngine::TimerId> > receiver;
+    std::vector<TimerEngine::TimerId> batch;
+public:
+    std::vector<double> expected;
+    std::vector<double> samples;
+
+    TimerConsumer(std::string name, unsigned int timers)
+        : RTT::TaskContext(name), receiver("TimeoutsIn"), batch(timers), expected(timers, 0.0)
+    {
+        ports()->addEventPort( receiver );
+        samples.reserve( timers );
+    }
+
+    void updateHook()
+    {
+        while ( receiver.read(batch, false) == NewData ) {
+            double now = TimerEngine::time();
+            for (unsigned int i = 0; i < batch.size(); ++i)
+                samples.push_back( now - expected[ batch[i] ] );
+        }
+    }
+};
+
+/* busy loop to load a cpu */
+class Load : public base::RunnableInterface
+{
+    volatile bool quit;
+public:
+    Load() : quit(false) {}
+    bool initialize() { quit = false; return true; }
+    void step() {}
+    void loop() { volatile double x = 0; while (!quit) x += 1.0; }
+    bool breakLoop() { quit = true; return true; }
+    void finalize() {}
+};
+
+static double percentile(std::vector<double>& v, double p)
+{
+    if ( v.empty() )
+        return 0.0;
+    std::sort(v.begin(), v.end());
+    unsigned int i = (unsigned int)(p / 100.0 * (v.size() - 1));
+    return v[i];
+}
+
+/**
+ * Usage: timerbench [timers] [load threads]
+ *
+ * For each rate, arms all timers at absolute times spread at that rate
+ * and reports the lateness percentiles, in microseconds, as seen by the
+ * timer thread and by a consumer component reading the timeouts port.
+ */
+int ORO_main( int argc, char** argv)
+{
+    unsigned int timers = argc > 1 ? atoi(argv[1]) : 1000;
+    unsigned int loads = argc > 2 ? atoi(argv[2]) : 0;
+    const double rates[] = { 100.0, 1000.0, 10000.0, 100000.0, 0.0 };
+
+    TimerComponent tcomp("Timer");
+    tcomp.setActivity( new Activity(ORO_SCHED_RT, os::HighestPriority, 0.0) );
+    tcomp.properties()->getPropertyType<unsigned int>("MaxDynamicTimers")->set( timers );
+
+    TimerConsumer consumer("Consumer", timers);
+    consumer.setActivity( new Activity(ORO_SCHED_RT, os::HighestPriority - 1, 0.0) );
+    consumer.ports()->getPort("TimeoutsIn")->connectTo( tcomp.ports()->getPort("timeouts"), ConnPolicy::buffer(timers) );
+
+    std::vector<Load*> load(loads);
+    std::vector<Activity*> load_act(loads);
+    for (unsigned int i = 0; i < loads; ++i) {
+        load[i] = new Load();
+        load_act[i] = new Activity(ORO_SCHED_OTHER, os::LowestPriority, 0.0, load[i], "load");
+        load_act[i]->start();
+    }
+
+    if ( !tcomp.configure() || !tcomp.start() || !consumer.start() ) {
+        cerr << "Could not start the timer component." << endl;
+        return 1;
+    }
+
+    OperationCaller<TimerEngine::TimerId(void)> allocate = tcomp.getOperation("allocateTimer");
+    OperationCaller<bool(TimerEngine::TimerId, double)> armAt = tcomp.getOperation("armTimerAt");
+    OperationCaller<void(void)> update = tcomp.getOperation("updateStatistics");
+    OperationCaller<void(void)> reset = tcomp.getOperation("resetStatistics");
+
+    std::vector<TimerEngine::TimerId> ids(timers);
+    for (unsigned int i = 0; i < timers; ++i)
+        ids[i] = allocate();
+
+    cout << timers << " timers, " << loads << " load threads, lateness in us" << endl;
+    cout << setw(10) << "rate/s"
+         << setw(10) << "t.p50" << setw(10) << "t.p99" << setw(10) << "t.max"
+         << setw(10) << "c.p50" << setw(10) << "c.p90" << setw(10) << "c.p99" << setw(10) << "c.max"
+         << setw(10) << "lost" << endl;
+
+    for (const double* rate = rates; *rate != 0.0; ++rate) {
+        reset();
+        consumer.samples.clear();
+
+        // the consumer reads expected as soon as the first timer
+        // fires, so fill it in completely before arming any timer.
+        double start = TimerEngine::time() + 0.1;
+        for (unsigned int i = 0; i < timers; ++i)
+            consumer.expected[ ids[i] ] = start + i / *rate;
+        for (unsigned int i = 0; i < timers; ++i)
+            armAt( ids[i], consumer.expected[ ids[i] ] );
+
+        TIME_SPEC ts;
+        double wait = 0.2 + timers / *rate;
+        ts.tv_sec = (long) wait;
+        ts.tv_nsec = (long) ((wait - ts.tv_sec) * 1e9);
+        rtos_nanosleep(&ts, 0);
+
+        update();
+        double tp50 = tcomp.properties()->getPropertyType<double>("LatenessP50")->get();
+        double tp99 = tcomp.properties()->getPropertyType<double>("LatenessP99")->get();
+        double tmax = tcomp.properties()->getPropertyType<double>("LatenessMax")->get();
+        unsigned int lost = timers - consumer.samples.size();
+
+        cout << setw(10) << *rate << fixed << setprecision(1)
+             << setw(10) << tp50 * 1e6 << setw(10) << tp99 * 1e6 << setw(10) << tmax * 1e6
+             << setw(10) << percentile(consumer.samples, 50) * 1e6
+             << setw(10) << percentile(consumer.samples, 90) * 1e6
+             << setw(10) << percentile(consumer.samples, 99) * 1e6
+             << setw(10) << percentile(consumer.samples, 100) * 1e6
+             << setw(10) << lost << endl;
+        cout.unsetf(ios::floatfield);
+    }
+
+    consumer.stop();
+    tcomp.stop();
+    for (unsigned int i = 0; i < loads; ++i) {
+        load_act[i]->stop();
+        delete load_act[i];
+        delete load[i];
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <timer/TimerEngine.hpp>
+
+#include <rtt/os/main.h>
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+#include <rtt/os/fosi.h>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace RTT;
+using namespace OCL;
+
+/**
+ * Records every batch of expired timers.
+ */
+class RecordingEngine
+    : public TimerEngine
+{
+    mutable os::Mutex lock;
+    std::vector<std::vector<TimerId> > batches;
+public:
+    RecordingEngine()
+        : TimerEngine(ORO_SCHED_OTHER, 0, "RecordingEngine")
+    {}
+
+    void expired(const std::vector<TimerId>& ids)
+    {
+        os::MutexLock locker(lock);
+        batches.push_back(ids);
+    }
+
+    std::vector<std::vector<TimerId> > taken()
+    {
+        os::MutexLock locker(lock);
+        std::vector<std::vector<TimerId> > r;
+        r.swap(batches);
+        return r;
+    }
+};
+
+static void sleepFor(double seconds)
+{
+    TIME_SPEC ts;
+    ts.tv_sec = (long) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+    rtos_nanosleep(&ts, 0);
+}
+
+static unsigned int count(const std::vector<std::vector<TimerEngine::TimerId> >& batches, TimerEngine::TimerId id)
+{
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < batches.size(); ++i)
+        n += std::count(batches[i].begin(), batches[i].end(), id);
+    return n;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if ( !ok ) {
+        cerr << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+/**
+ * Arms, cancels and runs single shot and periodic timers and checks
+ * the batches handed to expired().
+ */
+int ORO_main(int, char**)
+{
+    RecordingEngine engine;
+    check( engine.setMaxTimers(4), "setMaxTimers(4)" );
+
+    TimerEngine::TimerId a = engine.allocate(), b = engine.allocate();
+    TimerEngine::TimerId c = engine.allocate(), d = engine.allocate();
+    check( a >= 0 && b >= 0 && c >= 0 && d >= 0, "allocating four timers" );
+    check( engine.allocate() == -1, "a fifth timer must not be allocated" );
+
+    // nothing expires without the timer thread
+    check( engine.arm(a, 0.01) && !engine.waitFor(a), "waitFor() must fail without the timer thread" );
+    check( engine.cancel(a), "cancelling a" );
+    check( engine.getActivity()->start(), "starting the timer thread" );
+
+    // timers within the slack of each other are delivered in one batch
+    engine.setSlack(0.05);
+    check( engine.arm(a, 0.1) && engine.arm(b, 0.12) && engine.arm(c, 0.11), "arming a, b and c" );
+    check( engine.cancel(c), "cancelling c" );
+    check( !engine.isArmed(c) && !engine.cancel(c), "c is no longer armed" );
+    check( engine.waitFor(b), "waiting for b" );
+    sleepFor(0.1);
+    std::vector<std::vector<TimerEngine::TimerId> > batches = engine.taken();
+    check( batches.size() == 1 && batches[0].size() == 2, "a and b in one batch" );
+    check( count(batches, a) == 1 && count(batches, b) == 1, "a and b expire once" );
+    check( count(batches, c) == 0, "a cancelled timer does not expire" );
+    check( !engine.isArmed(a) && !engine.isArmed(b), "single shot timers are disarmed" );
+
+    // a timer beyond the slack is not delayed until the next one
+    check( engine.arm(a, 0.05) && engine.arm(b, 0.3), "arming a and b apart" );
+    sleepFor(0.15);
+    batches = engine.taken();
+    check( batches.size() == 1 && count(batches, a) == 1 && count(batches, b) == 0,
+           "a expires before b" );
+    check( engine.cancel(b), "cancelling b" );
+
+    // periodic timers keep their period until cancelled
+    engine.setSlack(0.0);
+    check( engine.startPeriodic(d, 0.02), "starting d with a period of 20ms" );
+    sleepFor(0.21);
+    check( engine.cancel(d), "cancelling d" );
+    batches = engine.taken();
+    unsigned int n = count(batches, d);
+    check( n >= 5 && n <= 11, "d expires about ten times" );
+    sleepFor(0.1);
+    batches = engine.taken();
+    check( batches.empty(), "a cancelled periodic timer does not expire" );
+
+    check( engine.release(a) && engine.release(b) && engine.release(c) && engine.release(d), "releasing the timers" );
+    check( engine.armed() == 0, "no timer is armed" );
+    engine.getActivity()->stop();
+
+    if ( failures )
+        cerr << failures << " checks failed." << endl;
+    else
+        cout << "All timer engine checks passed." << endl;
+    return failures ? 1 : 0;
+}